@@ -0,0 +1,245 @@
+// ECS micro benchmarks, comparing the storage policies of BasicRegistry and
+// ArchetypeRegistry. Results are printed as JSON (default) or CSV:
+//
+//     wil_benchmark_ecs [--csv] [--repeat N] [--out FILE] [SIZES...]
+//
+// Every benchmark is run --repeat times on fresh data, the minimum and median
+// times per entity are reported.
+
+#include <wil/ecs.hpp>
+#include <wil/archetype.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace wil;
+
+namespace {
+
+struct Position {
+	Fvec3 value;
+};
+
+struct Velocity {
+	Fvec3 value;
+};
+
+struct Health {
+	float value;
+};
+
+struct Result
+{
+	std::string name;
+	std::string storage;
+	size_t entities;
+	size_t repetitions;
+	double min_ns;
+	double median_ns;
+};
+
+// Keeps the optimizer from discarding benchmarked work.
+volatile float sink;
+
+using Clock = std::chrono::steady_clock;
+
+template<class R>
+constexpr bool HAS_VIEWS = !std::is_same_v<R, ArchetypeRegistry>;
+
+// Run setup then body repeat times, timing body only.
+template<class Setup, class Body>
+Result Measure(const char *name, const char *storage, size_t count, size_t repeat, Setup setup, Body body)
+{
+	std::vector<double> times;
+
+	for (size_t i = 0; i < repeat; ++i)
+	{
+		auto state = setup();
+		auto start = Clock::now();
+		body(*state);
+		auto end = Clock::now();
+		times.push_back(std::chrono::duration<double, std::nano>(end - start).count() / count);
+	}
+
+	std::sort(times.begin(), times.end());
+	return { name, storage, count, repeat, times.front(), times[times.size() / 2] };
+}
+
+template<class R>
+struct State
+{
+	R registry;
+	std::vector<Entity> entities;
+	EntityView view;
+};
+
+// Registry filled with count entities having Position and Velocity.
+template<class R>
+std::unique_ptr<State<R>> Populate(size_t count, bool with_view = false)
+{
+	auto state = std::make_unique<State<R>>();
+
+	if constexpr (HAS_VIEWS<R>)
+		if (with_view)
+			state->registry.template RegisterEntityView<Position, Velocity>(state->view);
+
+	state->entities = state->registry.CreateEntities(count,
+			Position{Fvec3(0.f)}, Velocity{Fvec3(1.f, 0.f, 0.f)});
+	return state;
+}
+
+template<class R>
+void RunStorage(const char *storage, size_t count, size_t repeat, std::vector<Result> &results)
+{
+	auto empty = [] { return std::make_unique<State<R>>(); };
+	auto populated = [count] { return Populate<R>(count); };
+
+	results.push_back(Measure("create", storage, count, repeat, empty, [count](State<R> &s) {
+		for (size_t i = 0; i < count; ++i)
+		{
+			Entity e = s.registry.CreateEntity();
+			s.registry.AddComponents(e, Position{Fvec3(0.f)}, Velocity{Fvec3(1.f, 0.f, 0.f)});
+		}
+	}));
+
+	results.push_back(Measure("create_bulk", storage, count, repeat, empty, [count](State<R> &s) {
+		s.registry.CreateEntities(count, Position{Fvec3(0.f)}, Velocity{Fvec3(1.f, 0.f, 0.f)});
+	}));
+
+	results.push_back(Measure("destroy", storage, count, repeat, populated, [](State<R> &s) {
+		for (Entity e : s.entities)
+			s.registry.DestroyEntity(e);
+	}));
+
+	results.push_back(Measure("destroy_bulk", storage, count, repeat, populated, [](State<R> &s) {
+		s.registry.DestroyEntities(s.entities);
+	}));
+
+	results.push_back(Measure("add_remove", storage, count, repeat, populated, [](State<R> &s) {
+		for (Entity e : s.entities)
+			s.registry.AddComponents(e, Health{1.f});
+		for (Entity e : s.entities)
+			s.registry.template RemoveComponents<Health>(e);
+	}));
+
+	results.push_back(Measure("each_single", storage, count, repeat, populated, [](State<R> &s) {
+		float sum = 0.f;
+		s.registry.template Each<Position>([&sum](Entity, Position &p) { sum += p.value.x; });
+		sink = sum;
+	}));
+
+	results.push_back(Measure("each_multi", storage, count, repeat, populated, [](State<R> &s) {
+		s.registry.template Each<Position, Velocity>([](Entity, Position &p, Velocity &v) {
+			p.value += v.value;
+		});
+	}));
+
+	if constexpr (HAS_VIEWS<R>)
+	{
+		auto viewed = [count] { return Populate<R>(count, true); };
+
+		results.push_back(Measure("view_multi", storage, count, repeat, viewed, [](State<R> &s) {
+			for (Entity e : s.view)
+			{
+				auto [p, v] = s.registry.template GetComponents<Position, Velocity>(e);
+				p.value += v.value;
+			}
+		}));
+	}
+
+	auto shuffled = [count] {
+		auto state = Populate<R>(count);
+		std::shuffle(state->entities.begin(), state->entities.end(), std::mt19937(42));
+		return state;
+	};
+
+	results.push_back(Measure("get_random", storage, count, repeat, shuffled, [](State<R> &s) {
+		float sum = 0.f;
+		for (Entity e : s.entities)
+			sum += s.registry.template GetComponent<Position>(e).value.x;
+		sink = sum;
+	}));
+}
+
+void PrintJson(FILE *out, std::vector<Result> const& results)
+{
+	std::fprintf(out, "{\n\t\"benchmarks\": [\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		auto const& r = results[i];
+		std::fprintf(out, "\t\t{ \"name\": \"%s\", \"storage\": \"%s\", \"entities\": %zu, \"repetitions\": %zu, "
+				"\"min_ns_per_entity\": %.3f, \"median_ns_per_entity\": %.3f }%s\n",
+				r.name.c_str(), r.storage.c_str(), r.entities, r.repetitions, r.min_ns, r.median_ns,
+				i + 1 < results.size() ? "," : "");
+	}
+	std::fprintf(out, "\t]\n}\n");
+}
+
+void PrintCsv(FILE *out, std::vector<Result> const& results)
+{
+	std::fprintf(out, "name,storage,entities,repetitions,min_ns_per_entity,median_ns_per_entity\n");
+	for (auto const& r : results)
+		std::fprintf(out, "%s,%s,%zu,%zu,%.3f,%.3f\n",
+				r.name.c_str(), r.storage.c_str(), r.entities, r.repetitions, r.min_ns, r.median_ns);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	bool csv = false;
+	size_t repeat = 5;
+	const char *path = nullptr;
+	std::vector<size_t> sizes;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp(argv[i], "--csv"))
+			csv = true;
+		else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+			repeat = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+			path = argv[++i];
+		else if (size_t size = std::strtoull(argv[i], nullptr, 10))
+			sizes.push_back(size);
+		else
+		{
+			std::fprintf(stderr, "Usage: %s [--csv] [--repeat N] [--out FILE] [SIZES...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (sizes.empty())
+		sizes = { 10'000, 100'000, 1'000'000 };
+
+	std::vector<Result> results;
+	for (size_t count : sizes)
+	{
+		RunStorage<Registry>("sparse", count, repeat, results);
+		RunStorage<BasicRegistry<MapComponentArray>>("map", count, repeat, results);
+		RunStorage<ArchetypeRegistry>("archetype", count, repeat, results);
+	}
+
+	FILE *out = path ? std::fopen(path, "w") : stdout;
+	if (!out)
+	{
+		std::fprintf(stderr, "Unable to open %s\n", path);
+		return 1;
+	}
+
+	if (csv)
+		PrintCsv(out, results);
+	else
+		PrintJson(out, results);
+
+	if (path)
+		std::fclose(out);
+	return 0;
+}
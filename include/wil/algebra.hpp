@@ -4,6 +4,13 @@
 #include <type_traits>
 #include <array>
 
+// SSE versions of the Fvec4 and Fmat4 operations are used when the target
+// supports them, unless WIL_DISABLE_SIMD is defined.
+#if !defined(WIL_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define WIL_SIMD_SSE
+#include <immintrin.h>
+#endif
+
 namespace wil {
 
 constexpr float Radians(float deg) {
@@ -731,7 +738,7 @@ constexpr auto operator*(Matrix<T1, Rw, Cn> const& mat, ScT scale)
 {
 	Matrix<decltype(mat[0][0] * scale), Rw, Cn> res;
 	for (unsigned i = 0; i < mat.vec_count; i++)
-		res[i] = mat * scale;
+		res[i] = mat[i] * scale;
 	return res;
 }
 
@@ -763,6 +770,83 @@ constexpr auto Transpose(Matrix<T, Rw, Cn> const& mat)
 	return res;
 }
 
+// Inverse of an invertible 4x4 matrix, from its 2x2 sub-determinants
+template<class T>
+constexpr auto Inverse(Matrix<T, 4, 4> const& m)
+{
+	T s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+	T s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+	T s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+	T s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+	T s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+	T s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+
+	T c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+	T c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+	T c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+	T c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+	T c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+	T c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+
+	T inv = 1 / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+	Matrix<T, 4, 4> res;
+	res(0, 0) = ( m(1, 1) * c5 - m(1, 2) * c4 + m(1, 3) * c3) * inv;
+	res(0, 1) = (-m(0, 1) * c5 + m(0, 2) * c4 - m(0, 3) * c3) * inv;
+	res(0, 2) = ( m(3, 1) * s5 - m(3, 2) * s4 + m(3, 3) * s3) * inv;
+	res(0, 3) = (-m(2, 1) * s5 + m(2, 2) * s4 - m(2, 3) * s3) * inv;
+	res(1, 0) = (-m(1, 0) * c5 + m(1, 2) * c2 - m(1, 3) * c1) * inv;
+	res(1, 1) = ( m(0, 0) * c5 - m(0, 2) * c2 + m(0, 3) * c1) * inv;
+	res(1, 2) = (-m(3, 0) * s5 + m(3, 2) * s2 - m(3, 3) * s1) * inv;
+	res(1, 3) = ( m(2, 0) * s5 - m(2, 2) * s2 + m(2, 3) * s1) * inv;
+	res(2, 0) = ( m(1, 0) * c4 - m(1, 1) * c2 + m(1, 3) * c0) * inv;
+	res(2, 1) = (-m(0, 0) * c4 + m(0, 1) * c2 - m(0, 3) * c0) * inv;
+	res(2, 2) = ( m(3, 0) * s4 - m(3, 1) * s2 + m(3, 3) * s0) * inv;
+	res(2, 3) = (-m(2, 0) * s4 + m(2, 1) * s2 - m(2, 3) * s0) * inv;
+	res(3, 0) = (-m(1, 0) * c3 + m(1, 1) * c1 - m(1, 2) * c0) * inv;
+	res(3, 1) = ( m(0, 0) * c3 - m(0, 1) * c1 + m(0, 2) * c0) * inv;
+	res(3, 2) = (-m(3, 0) * s3 + m(3, 1) * s1 - m(3, 2) * s0) * inv;
+	res(3, 3) = ( m(2, 0) * s3 - m(2, 1) * s1 + m(2, 2) * s0) * inv;
+	return res;
+}
+
+// Transpose of the inverse, transforms normals of an invertible matrix
+template<class T>
+constexpr auto InverseTranspose(Matrix<T, 4, 4> const& m)
+{
+	return Transpose(Inverse(m));
+}
+
+// Inverse of an affine matrix, whose last row is (0, 0, 0, 1), built from
+// the cross products of its 3x3 part
+template<class T>
+constexpr auto AffineInverse(Matrix<T, 4, 4> const& m)
+{
+	Vector<T, 3> c0 = { m(0, 0), m(1, 0), m(2, 0) };
+	Vector<T, 3> c1 = { m(0, 1), m(1, 1), m(2, 1) };
+	Vector<T, 3> c2 = { m(0, 2), m(1, 2), m(2, 2) };
+	Vector<T, 3> t = { m(0, 3), m(1, 3), m(2, 3) };
+
+	// Rows of the inverse of the 3x3 part
+	Vector<T, 3> r0 = Cross(c1, c2), r1 = Cross(c2, c0), r2 = Cross(c0, c1);
+	T inv = 1 / Dot(c0, r0);
+	r0 = r0 * inv, r1 = r1 * inv, r2 = r2 * inv;
+
+	Matrix<T, 4, 4> res(1);
+	for (unsigned j = 0; j < 3; ++j)
+		res(0, j) = r0[j], res(1, j) = r1[j], res(2, j) = r2[j];
+	res(0, 3) = -Dot(r0, t), res(1, 3) = -Dot(r1, t), res(2, 3) = -Dot(r2, t);
+	return res;
+}
+
+// Transpose of the inverse of an affine matrix, its 3x3 part is the normal
+// matrix
+template<class T>
+constexpr auto AffineInverseTranspose(Matrix<T, 4, 4> const& m)
+{
+	return Transpose(AffineInverse(m));
+}
+
 // Matrix multiplication operation
 template<class T1, class T2, unsigned Rw1, unsigned Rw2Cn1, unsigned Cn2>
 constexpr auto operator*(Matrix<T1, Rw1, Rw2Cn1> const& mat1, Matrix<T2, Rw2Cn1, Cn2> const& mat2)
@@ -822,4 +906,440 @@ constexpr auto operator*(Matrix<T1, Rw1, Dim> const& mat, Vector<T2, Dim> const&
 #endif
 }
 
+// Quaternion x i + y j + z k + w, used as rotation when normalized
+template<class T>
+class Quaternion
+{
+public:
+
+	T x, y, z, w;
+
+	constexpr Quaternion() noexcept = default;
+
+	constexpr Quaternion(auto x, auto y, auto z, auto w) noexcept
+	{
+		this->x = static_cast<T>(x);
+		this->y = static_cast<T>(y);
+		this->z = static_cast<T>(z);
+		this->w = static_cast<T>(w);
+	}
+
+	// No rotation
+	static constexpr Quaternion Identity()
+	{
+		return Quaternion(0, 0, 0, 1);
+	}
+
+	// Rotation of rad radians about axis
+	static Quaternion AxisAngle(T rad, Vector<T, 3> axis)
+	{
+		auto s = std::sin(rad / 2) / axis.Norm();
+		return Quaternion(axis.x * s, axis.y * s, axis.z * s, std::cos(rad / 2));
+	}
+
+	auto Norm() const
+	{
+		return std::sqrt(x * x + y * y + z * z + w * w);
+	}
+
+	// Rotate a vector, the quaternion must be normalized
+	constexpr Vector<T, 3> Rotate(Vector<T, 3> const& vec) const
+	{
+		Vector<T, 3> u = { x, y, z };
+		Vector<T, 3> t = static_cast<T>(2) * Cross(u, vec);
+		return vec + w * t + Cross(u, t);
+	}
+};
+
+// -------------------- Tpedefs ---------------------- //
+
+inline namespace algebra {
+
+	using Fquat = Quaternion<float>;
+
+}
+
+// ------------------------------------ Functions ------------------------------------ //
+
+template<class T1, class T2>
+constexpr bool operator==(Quaternion<T1> const& q1, Quaternion<T2> const& q2)
+{
+	return q1.x == q2.x && q1.y == q2.y && q1.z == q2.z && q1.w == q2.w;
+}
+
+// Hamilton product, rotating by q2 then by q1
+template<class T1, class T2>
+constexpr auto operator*(Quaternion<T1> const& q1, Quaternion<T2> const& q2)
+{
+	return Quaternion<std::common_type_t<T1, T2>>
+	{
+		q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y,
+		q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x,
+		q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w,
+		q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z
+	};
+}
+
+// Inverse rotation of a normalized quaternion
+template<class T>
+constexpr auto Conjugate(Quaternion<T> const& q)
+{
+	return Quaternion<T>(-q.x, -q.y, -q.z, q.w);
+}
+
+template<class T1, class T2>
+constexpr auto Dot(Quaternion<T1> const& q1, Quaternion<T2> const& q2)
+{
+	return q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+}
+
+template<class T>
+auto Normalize(Quaternion<T> const& q)
+{
+	auto inv = 1 / q.Norm();
+	return Quaternion<T>(q.x * inv, q.y * inv, q.z * inv, q.w * inv);
+}
+
+// Normalize a quaternion whose norm is close to 1, as after composing
+// normalized rotations, without square root: 1 / sqrt(n) ~ (3 - n) / 2
+template<class T>
+constexpr auto FastNormalize(Quaternion<T> const& q)
+{
+	T scale = (3 - Dot(q, q)) / 2;
+	return Quaternion<T>(q.x * scale, q.y * scale, q.z * scale, q.w * scale);
+}
+
+// Compose normalized rotations, rotating by q2 then by q1, keeping the
+// result normalized over repeated compositions
+template<class T>
+constexpr auto ComposeRotations(Quaternion<T> const& q1, Quaternion<T> const& q2)
+{
+	return FastNormalize(q1 * q2);
+}
+
+// Normalized linear interpolation, following the shortest path
+template<class T>
+auto Nlerp(Quaternion<T> const& q1, Quaternion<T> const& q2, T t)
+{
+	T s = Dot(q1, q2) < 0 ? -t : t;
+	return Normalize(Quaternion<T>(
+		q1.x * (1 - t) + q2.x * s,
+		q1.y * (1 - t) + q2.y * s,
+		q1.z * (1 - t) + q2.z * s,
+		q1.w * (1 - t) + q2.w * s));
+}
+
+// Spherical linear interpolation, following the shortest path
+template<class T>
+auto Slerp(Quaternion<T> const& q1, Quaternion<T> const& q2, T t)
+{
+	T cos = Dot(q1, q2);
+	T sign = cos < 0 ? -1 : 1;
+	cos *= sign;
+
+	// Nearly parallel, the linear interpolation is accurate
+	if (cos > static_cast<T>(0.9995))
+		return Nlerp(q1, q2, t);
+
+	T angle = std::acos(cos);
+	T inv = 1 / std::sin(angle);
+	T s1 = std::sin((1 - t) * angle) * inv;
+	T s2 = std::sin(t * angle) * inv * sign;
+
+	return Quaternion<T>(
+		q1.x * s1 + q2.x * s2,
+		q1.y * s1 + q2.y * s2,
+		q1.z * s1 + q2.z * s2,
+		q1.w * s1 + q2.w * s2);
+}
+
+// ------------------------------ SIMD specializations ------------------------------ //
+
+// Exact matches for Fvec4 and Fmat4 are preferred over the generic templates.
+// Constant evaluation and targets without SSE use the generic versions.
+
+#ifdef WIL_SIMD_SSE
+
+static_assert(sizeof(Fvec4) == 4 * sizeof(float) && sizeof(Fmat4) == 16 * sizeof(float));
+
+inline __m128 Load_(Fvec4 const& vec)
+{
+	return _mm_loadu_ps(&vec.x);
+}
+
+inline void Store_(Fvec4 &vec, __m128 value)
+{
+	_mm_storeu_ps(&vec.x, value);
+}
+
+// a * b + c
+inline __m128 MulAdd_(__m128 a, __m128 b, __m128 c)
+{
+#ifdef __FMA__
+	return _mm_fmadd_ps(a, b, c);
+#else
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// Dot product broadcast to every lane
+inline __m128 Dot_(__m128 a, __m128 b)
+{
+	__m128 mul = _mm_mul_ps(a, b);
+	__m128 shuf = _mm_shuffle_ps(mul, mul, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sum = _mm_add_ps(mul, shuf);
+	shuf = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2));
+	return _mm_add_ps(sum, shuf);
+}
+
+// b[0] * vec[0] + b[1] * vec[1] + b[2] * vec[2] + b[3] * vec[3]
+inline __m128 Combine_(Fmat4 const& b, __m128 vec)
+{
+	__m128 res = _mm_mul_ps(Load_(b[0]), _mm_shuffle_ps(vec, vec, _MM_SHUFFLE(0, 0, 0, 0)));
+	res = MulAdd_(Load_(b[1]), _mm_shuffle_ps(vec, vec, _MM_SHUFFLE(1, 1, 1, 1)), res);
+	res = MulAdd_(Load_(b[2]), _mm_shuffle_ps(vec, vec, _MM_SHUFFLE(2, 2, 2, 2)), res);
+	return MulAdd_(Load_(b[3]), _mm_shuffle_ps(vec, vec, _MM_SHUFFLE(3, 3, 3, 3)), res);
+}
+
+// Cross product of the xyz lanes, w lane is 0
+inline __m128 Cross_(__m128 a, __m128 b)
+{
+	__m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// 2x2 matrices stored (m00, m01, m10, m11) in one register: a * b
+inline __m128 Mat2Mul_(__m128 a, __m128 b)
+{
+	return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+		_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+
+// Adjugate(a) * b
+inline __m128 Mat2AdjMul_(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+		_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+
+// a * adjugate(b)
+inline __m128 Mat2MulAdj_(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+		_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+
+// Columns of the affine inverse transpose: the cross products of the 3x3
+// columns over the determinant, with minus the inverse translation in w
+inline void AffineInverseTranspose_(Fmat4 const& mat, __m128 res[3])
+{
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+	Fmat4 const cols = Transpose(mat);
+#else
+	Fmat4 const& cols = mat;
+#endif
+	__m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	__m128 c0 = _mm_and_ps(Load_(cols[0]), mask);
+	__m128 c1 = _mm_and_ps(Load_(cols[1]), mask);
+	__m128 c2 = _mm_and_ps(Load_(cols[2]), mask);
+	__m128 t = _mm_and_ps(Load_(cols[3]), mask);
+
+	__m128 r0 = Cross_(c1, c2), r1 = Cross_(c2, c0), r2 = Cross_(c0, c1);
+	__m128 inv = _mm_div_ps(_mm_set1_ps(1.f), Dot_(c0, r0));
+	r0 = _mm_mul_ps(r0, inv), r1 = _mm_mul_ps(r1, inv), r2 = _mm_mul_ps(r2, inv);
+
+	// Translation goes in the w lanes, which are 0
+	__m128 w = _mm_setr_ps(0.f, 0.f, 0.f, -1.f);
+	res[0] = MulAdd_(Dot_(r0, t), w, r0);
+	res[1] = MulAdd_(Dot_(r1, t), w, r1);
+	res[2] = MulAdd_(Dot_(r2, t), w, r2);
+}
+
+#endif
+
+constexpr float Dot(Fvec4 const& vec1, Fvec4 const& vec2)
+{
+#ifdef WIL_SIMD_SSE
+	if (!std::is_constant_evaluated())
+		return _mm_cvtss_f32(Dot_(Load_(vec1), Load_(vec2)));
+#endif
+	return Dot<float, float, 4>(vec1, vec2);
+}
+
+constexpr Fvec4 Normalize(Fvec4 const& vec)
+{
+#ifdef WIL_SIMD_SSE
+	if (!std::is_constant_evaluated())
+	{
+		__m128 v = Load_(vec);
+		Fvec4 res;
+		Store_(res, _mm_div_ps(v, _mm_sqrt_ps(Dot_(v, v))));
+		return res;
+	}
+#endif
+	return Normalize<float, 4>(vec);
+}
+
+constexpr Fmat4 Transpose(Fmat4 const& mat)
+{
+#ifdef WIL_SIMD_SSE
+	if (!std::is_constant_evaluated())
+	{
+		__m128 v0 = Load_(mat[0]), v1 = Load_(mat[1]), v2 = Load_(mat[2]), v3 = Load_(mat[3]);
+		_MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+
+		Fmat4 res;
+		Store_(res[0], v0);
+		Store_(res[1], v1);
+		Store_(res[2], v2);
+		Store_(res[3], v3);
+		return res;
+	}
+#endif
+	return Transpose<float, 4, 4>(mat);
+}
+
+// Column major: res[j] = sum of mat1[k] * mat2[j][k]
+// Row major: res[i] = sum of mat2[k] * mat1[i][k]
+constexpr Fmat4 operator*(Fmat4 const& mat1, Fmat4 const& mat2)
+{
+#ifdef WIL_SIMD_SSE
+	if (!std::is_constant_evaluated())
+	{
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+		Fmat4 const& vecs = mat2;
+		Fmat4 const& weights = mat1;
+#else
+		Fmat4 const& vecs = mat1;
+		Fmat4 const& weights = mat2;
+#endif
+		Fmat4 res;
+		for (unsigned i = 0; i < 4; ++i)
+			Store_(res[i], Combine_(vecs, Load_(weights[i])));
+		return res;
+	}
+#endif
+	return operator*<float, float, 4, 4, 4>(mat1, mat2);
+}
+
+constexpr Fvec4 operator*(Fmat4 const& mat, Fvec4 const& vec)
+{
+#ifdef WIL_SIMD_SSE
+	if (!std::is_constant_evaluated())
+	{
+		Fvec4 res;
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+		Store_(res, Combine_(Transpose(mat), Load_(vec)));
+#else
+		Store_(res, Combine_(mat, Load_(vec)));
+#endif
+		return res;
+	}
+#endif
+	return operator*<float, float, 4, 4>(mat, vec);
+}
+
+// Block inversion on 2x2 sub-matrices. The inverse of the transpose is the
+// transpose of the inverse, so the same code serves both layouts.
+constexpr Fmat4 Inverse(Fmat4 const& mat)
+{
+#ifdef WIL_SIMD_SSE
+	if (!std::is_constant_evaluated())
+	{
+		__m128 v0 = Load_(mat[0]), v1 = Load_(mat[1]), v2 = Load_(mat[2]), v3 = Load_(mat[3]);
+
+		__m128 a = _mm_movelh_ps(v0, v1), b = _mm_movehl_ps(v1, v0);
+		__m128 c = _mm_movelh_ps(v2, v3), d = _mm_movehl_ps(v3, v2);
+
+		// Determinants of a, b, c and d
+		__m128 dets = _mm_sub_ps(
+			_mm_mul_ps(_mm_shuffle_ps(v0, v2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(v1, v3, _MM_SHUFFLE(3, 1, 3, 1))),
+			_mm_mul_ps(_mm_shuffle_ps(v0, v2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(v1, v3, _MM_SHUFFLE(2, 0, 2, 0))));
+		__m128 det_a = _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 det_b = _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 det_c = _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 det_d = _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(3, 3, 3, 3));
+
+		__m128 d_c = Mat2AdjMul_(d, c);
+		__m128 a_b = Mat2AdjMul_(a, b);
+
+		// Adjugates of the blocks of the inverse
+		__m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), Mat2Mul_(b, d_c));
+		__m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), Mat2Mul_(c, a_b));
+		__m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), Mat2MulAdj_(d, a_b));
+		__m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), Mat2MulAdj_(a, d_c));
+
+		// |M| = |A| |D| + |B| |C| - tr(A# B D# C)
+		__m128 det = _mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c));
+		det = _mm_sub_ps(det, Dot_(a_b, _mm_shuffle_ps(d_c, d_c, _MM_SHUFFLE(3, 1, 2, 0))));
+
+		__m128 inv = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det);
+		x = _mm_mul_ps(x, inv), y = _mm_mul_ps(y, inv);
+		z = _mm_mul_ps(z, inv), w = _mm_mul_ps(w, inv);
+
+		Fmat4 res;
+		Store_(res[0], _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+		Store_(res[1], _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+		Store_(res[2], _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+		Store_(res[3], _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+		return res;
+	}
+#endif
+	return Inverse<float>(mat);
+}
+
+constexpr Fmat4 InverseTranspose(Fmat4 const& mat)
+{
+	return Transpose(Inverse(mat));
+}
+
+constexpr Fmat4 AffineInverse(Fmat4 const& mat)
+{
+#ifdef WIL_SIMD_SSE
+	if (!std::is_constant_evaluated())
+	{
+		__m128 r[3];
+		AffineInverseTranspose_(mat, r);
+		__m128 r3 = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+		// Rows of the inverse, transposed back to columns
+#ifndef WIL_FORCE_MATRIX_ROW_MAJOR
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r3);
+#endif
+		Fmat4 res;
+		Store_(res[0], r[0]);
+		Store_(res[1], r[1]);
+		Store_(res[2], r[2]);
+		Store_(res[3], r3);
+		return res;
+	}
+#endif
+	return AffineInverse<float>(mat);
+}
+
+constexpr Fmat4 AffineInverseTranspose(Fmat4 const& mat)
+{
+#ifdef WIL_SIMD_SSE
+	if (!std::is_constant_evaluated())
+	{
+		__m128 r[3];
+		AffineInverseTranspose_(mat, r);
+		__m128 r3 = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r3);
+#endif
+		Fmat4 res;
+		Store_(res[0], r[0]);
+		Store_(res[1], r[1]);
+		Store_(res[2], r[2]);
+		Store_(res[3], r3);
+		return res;
+	}
+#endif
+	return AffineInverseTranspose<float>(mat);
+}
+
 }
@@ -0,0 +1,469 @@
+#pragma once
+
+#include "core.hpp"
+#include "ecs.hpp"
+
+#include <array>
+#include <tuple>
+#include <utility>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+
+namespace wil {
+
+// Every archetype chunk occupies exactly this many bytes.
+constexpr size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+
+// Alignment of chunks, the largest alignment a component may require.
+constexpr size_t ARCHETYPE_CHUNK_ALIGNMENT = 64;
+
+// Type erased operations of a component stored in archetype chunks.
+struct ComponentInfo
+{
+	size_t size;
+	size_t alignment;
+
+	// Move construct dst from src and destroy src.
+	void (*relocate)(void *dst, void *src);
+	void (*destroy)(void *ptr);
+};
+
+template<class T>
+ComponentInfo const* GetComponentInfo_()
+{
+	static_assert(alignof(T) <= ARCHETYPE_CHUNK_ALIGNMENT, "Component alignment exceeds the chunk alignment");
+
+	static const ComponentInfo info = {
+		sizeof(T),
+		alignof(T),
+		[](void *dst, void *src) {
+			new (dst) T(std::move(*static_cast<T*>(src)));
+			static_cast<T*>(src)->~T();
+		},
+		[](void *ptr) {
+			static_cast<T*>(ptr)->~T();
+		}
+	};
+	return &info;
+}
+
+// A set of entities sharing the same signature. Components are stored in
+// fixed size chunks, each chunk holding one contiguous array per component
+// type (SoA), preceded by the array of entities living in the chunk.
+class Archetype
+{
+public:
+
+	struct Chunk
+	{
+		std::byte *data;
+		uint32_t count;
+	};
+
+	Archetype(Signature signature, const std::array<ComponentInfo const*, MAX_COMPONENTS> &infos)
+		: signature_(signature)
+	{
+		column_of_.fill(-1);
+
+		size_t bytes_per_entity = sizeof(Entity);
+		size_t max_alignment = alignof(Entity);
+
+		for (size_t i = 0; i < MAX_COMPONENTS; ++i)
+		{
+			if (!signature.test(i))
+				continue;
+			column_of_[i] = static_cast<int8_t>(columns_.size());
+			columns_.push_back({infos[i], 0});
+			bytes_per_entity += infos[i]->size;
+			max_alignment = std::max(max_alignment, infos[i]->alignment);
+		}
+
+		// Reserve worst case padding of every column, then lay the columns out.
+		size_t padding = max_alignment * (columns_.size() + 1);
+		capacity_ = static_cast<uint32_t>((ARCHETYPE_CHUNK_SIZE - padding) / bytes_per_entity);
+		if (!capacity_)
+			capacity_ = 1;
+
+		size_t offset = sizeof(Entity) * capacity_;
+		for (auto &column : columns_)
+		{
+			offset = (offset + column.info->alignment - 1) & ~(column.info->alignment - 1);
+			column.offset = offset;
+			offset += column.info->size * capacity_;
+		}
+
+		chunk_bytes_ = std::max(offset, ARCHETYPE_CHUNK_SIZE);
+	}
+
+	~Archetype()
+	{
+		for (auto &chunk : chunks_)
+		{
+			for (auto &column : columns_)
+				for (uint32_t i = 0; i < chunk.count; ++i)
+					column.info->destroy(chunk.data + column.offset + i * column.info->size);
+			::operator delete(chunk.data, std::align_val_t(CHUNK_ALIGNMENT_));
+		}
+	}
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(Archetype);
+
+	Signature GetSignature() const { return signature_; }
+
+	uint32_t GetChunkCapacity() const { return capacity_; }
+
+	std::vector<Chunk> const& GetChunks() const { return chunks_; }
+
+	size_t GetSize() const { return chunks_.empty() ? 0 : (chunks_.size() - 1) * capacity_ + chunks_.back().count; }
+
+	Entity* GetEntities(Chunk const& chunk) const
+	{
+		return reinterpret_cast<Entity*>(chunk.data);
+	}
+
+	// Pointer to the first element of a component array in a chunk.
+	template<class T>
+	T* GetColumn(Chunk const& chunk, ComponentType type) const
+	{
+		return reinterpret_cast<T*>(chunk.data + columns_[column_of_[type]].offset);
+	}
+
+	void* GetComponent(uint32_t chunk, uint32_t row, ComponentType type) const
+	{
+		auto const& column = columns_[column_of_[type]];
+		return chunks_[chunk].data + column.offset + row * column.info->size;
+	}
+
+	// Append an entity with uninitialized components, returns its location.
+	std::pair<uint32_t, uint32_t> AllocateRow(Entity entity)
+	{
+		if (chunks_.empty() || chunks_.back().count == capacity_)
+		{
+			auto data = static_cast<std::byte*>(::operator new(chunk_bytes_, std::align_val_t(CHUNK_ALIGNMENT_)));
+			chunks_.push_back({data, 0});
+		}
+
+		auto &chunk = chunks_.back();
+		uint32_t row = chunk.count++;
+		GetEntities(chunk)[row] = entity;
+		return { static_cast<uint32_t>(chunks_.size() - 1), row };
+	}
+
+	// Fill the hole at (chunk, row) with the last entity of the archetype.
+	// Components at (chunk, row) must be already destroyed or relocated.
+	// Returns the entity moved into the hole, or the removed entity itself.
+	Entity FreeRow(uint32_t chunk, uint32_t row)
+	{
+		auto &last = chunks_.back();
+		uint32_t last_row = last.count - 1;
+		Entity moved = GetEntities(last)[last_row];
+
+		if (&chunks_[chunk] != &last || row != last_row)
+		{
+			auto &dst = chunks_[chunk];
+			for (auto &column : columns_)
+			{
+				size_t size = column.info->size;
+				column.info->relocate(dst.data + column.offset + row * size,
+						last.data + column.offset + last_row * size);
+			}
+			GetEntities(dst)[row] = moved;
+		}
+
+		if (--last.count == 0)
+		{
+			::operator delete(last.data, std::align_val_t(CHUNK_ALIGNMENT_));
+			chunks_.pop_back();
+		}
+
+		return moved;
+	}
+
+	// Destroy every component at (chunk, row).
+	void DestroyRow(uint32_t chunk, uint32_t row)
+	{
+		for (auto &column : columns_)
+			column.info->destroy(chunks_[chunk].data + column.offset + row * column.info->size);
+	}
+
+	// Relocate shared components at (chunk, row) into dst and destroy the rest.
+	void RelocateRow(uint32_t chunk, uint32_t row, Archetype &dst, uint32_t dst_chunk, uint32_t dst_row)
+	{
+		for (size_t i = 0; i < MAX_COMPONENTS; ++i)
+		{
+			if (column_of_[i] < 0)
+				continue;
+			void *src = GetComponent(chunk, row, static_cast<ComponentType>(i));
+			if (dst.column_of_[i] < 0)
+				columns_[column_of_[i]].info->destroy(src);
+			else
+				columns_[column_of_[i]].info->relocate(dst.GetComponent(dst_chunk, dst_row, static_cast<ComponentType>(i)), src);
+		}
+	}
+
+private:
+
+	static constexpr size_t CHUNK_ALIGNMENT_ = ARCHETYPE_CHUNK_ALIGNMENT;
+
+	struct Column
+	{
+		ComponentInfo const* info;
+		size_t offset;
+	};
+
+	Signature signature_;
+	std::vector<Column> columns_;
+	std::array<int8_t, MAX_COMPONENTS> column_of_;
+	uint32_t capacity_;
+	size_t chunk_bytes_;
+	std::vector<Chunk> chunks_;
+};
+
+// Registry storing components by archetype instead of per component arrays.
+// Entities with the same signature are packed together, so Each<Ts...> walks
+// contiguous arrays without any per entity lookup. Structural changes move
+// the entity between archetypes and are more expensive than in Registry.
+class ArchetypeRegistry
+{
+public:
+
+	ArchetypeRegistry(size_t entities_reserve = 1000) : entities_count(0)
+	{
+		locations_.reserve(entities_reserve);
+		infos_.fill(nullptr);
+	}
+
+	// Entity methods
+	Entity CreateEntity()
+	{
+		++entities_count;
+
+		Entity e = AllocateEntity_();
+		Archetype &empty = GetArchetype_(Signature());
+		auto [chunk, row] = empty.AllocateRow(e);
+		locations_[EntityIndex(e)] = { &empty, chunk, row, e };
+		return e;
+	}
+
+	// Create count entities, each with a copy of components, directly in
+	// their final archetype.
+	template<class... Ts>
+	std::vector<Entity> CreateEntities(size_t count, const Ts&... components)
+	{
+		(RegisterComponent<Ts>(), ...);
+
+		Signature signature;
+		(signature.set(GetComponentType<Ts>(), true), ...);
+		Archetype &archetype = GetArchetype_(signature);
+
+		std::vector<Entity> entities(count);
+		for (Entity &e : entities)
+		{
+			e = AllocateEntity_();
+			auto [chunk, row] = archetype.AllocateRow(e);
+			locations_[EntityIndex(e)] = { &archetype, chunk, row, e };
+			(new (archetype.GetComponent(chunk, row, GetComponentType<Ts>())) Ts(components), ...);
+		}
+
+		entities_count += count;
+		return entities;
+	}
+
+	// Destroying a stale or already destroyed entity does nothing.
+	void DestroyEntity(Entity entity)
+	{
+		if (!IsAlive(entity))
+			return;
+
+		auto &loc = locations_[EntityIndex(entity)];
+		loc.archetype->DestroyRow(loc.chunk, loc.row);
+		FreeRow_(loc);
+		loc.archetype = nullptr;
+		loc.handle = NULL_ENTITY;
+
+		refill_entities_.push_back(MakeEntity(EntityIndex(entity), EntityGeneration(entity) + 1));
+		--entities_count;
+	}
+
+	void DestroyEntities(std::span<const Entity> entities)
+	{
+		for (Entity entity : entities)
+			DestroyEntity(entity);
+	}
+
+	// False for handles of destroyed entities, even if their index is reused.
+	bool IsAlive(Entity entity) const
+	{
+		uint32_t index = EntityIndex(entity);
+		return index < locations_.size() && locations_[index].handle == entity;
+	}
+
+	// Component methods
+	template<typename T>
+	void RegisterComponent()
+	{
+		infos_[GetComponentType<T>()] = GetComponentInfo_<T>();
+	}
+
+	template<class... Ts>
+	void AddComponents(Entity entity, Ts... components)
+	{
+		(RegisterComponent<std::remove_reference_t<Ts>>(), ...);
+
+		auto &loc = locations_[EntityIndex(entity)];
+		Signature previous = loc.archetype->GetSignature();
+		Signature signature = previous;
+		(signature.set(GetComponentType<Ts>(), true), ...);
+
+		MoveEntity_(entity, signature);
+
+		// Components the entity already had are replaced, only the slots
+		// added by the move are constructed
+		auto store = [&]<class T>(T &&component) {
+			void *slot = loc.archetype->GetComponent(loc.chunk, loc.row, GetComponentType<T>());
+			if (previous.test(GetComponentType<T>()))
+				*static_cast<T*>(slot) = std::move(component);
+			else
+				new (slot) T(std::move(component));
+		};
+		(store.template operator()<Ts>(std::move(components)), ...);
+	}
+
+	template<class... Ts>
+	void RemoveComponents(Entity entity)
+	{
+		Signature signature = locations_[EntityIndex(entity)].archetype->GetSignature();
+		(signature.set(GetComponentType<Ts>(), false), ...);
+		MoveEntity_(entity, signature);
+	}
+
+	template<typename T>
+	T& GetComponent(Entity entity)
+	{
+		auto &loc = locations_[EntityIndex(entity)];
+		return *static_cast<T*>(loc.archetype->GetComponent(loc.chunk, loc.row, GetComponentType<T>()));
+	}
+
+	template<class... Ts>
+	std::tuple<Ts&...> GetComponents(Entity entity)
+	{
+		return std::tie<Ts&...>(GetComponent<Ts>(entity)...);
+	}
+
+	template<class... Ts>
+	bool HasComponents(Entity entity)
+	{
+		return (locations_[EntityIndex(entity)].archetype->GetSignature().test(GetComponentType<Ts>()) && ...);
+	}
+
+	template<typename T>
+	static ComponentType GetComponentType()
+	{
+		return GetComponentTypeId<T>();
+	}
+
+	// Invoke fn(Entity, Ts&...) on every entity having all components Ts.
+	template<class... Ts, class Fn>
+	void Each(Fn &&fn)
+	{
+		(RegisterComponent<Ts>(), ...);
+
+		Signature pass;
+		std::array<ComponentType, sizeof...(Ts)> types = { GetComponentType<Ts>()... };
+		for (auto type : types)
+			pass.set(type, true);
+
+		for (auto &[signature, archetype] : archetypes_)
+		{
+			if ((signature & pass) != pass)
+				continue;
+
+			for (auto const& chunk : archetype->GetChunks())
+			{
+				Entity *entities = archetype->GetEntities(chunk);
+				EachChunk_<Ts...>(*archetype, chunk, entities, types, fn, std::index_sequence_for<Ts...>{});
+			}
+		}
+	}
+
+	size_t GetEntitiesCount() const { return entities_count; }
+
+private:
+
+	struct EntityLocation
+	{
+		Archetype *archetype;
+		uint32_t chunk;
+		uint32_t row;
+		Entity handle;
+	};
+
+	Entity AllocateEntity_()
+	{
+		if (refill_entities_.empty())
+		{
+			WIL_ASSERT(locations_.size() < ENTITY_INDEX_MASK);
+			locations_.push_back({ nullptr, 0, 0, NULL_ENTITY });
+			return static_cast<Entity>(locations_.size() - 1);
+		}
+
+		Entity e = refill_entities_.back();
+		refill_entities_.pop_back();
+		return e;
+	}
+
+	template<class... Ts, class Fn, size_t... Is>
+	static void EachChunk_(Archetype &archetype, Archetype::Chunk const& chunk, Entity *entities,
+			std::array<ComponentType, sizeof...(Ts)> const& types, Fn &fn, std::index_sequence<Is...>)
+	{
+		std::tuple<Ts*...> columns = { archetype.GetColumn<Ts>(chunk, types[Is])... };
+		for (uint32_t i = 0; i < chunk.count; ++i)
+			fn(entities[i], std::get<Is>(columns)[i]...);
+	}
+
+	Archetype &GetArchetype_(Signature signature)
+	{
+		auto &archetype = archetypes_[signature];
+		if (!archetype)
+			archetype = std::make_unique<Archetype>(signature, infos_);
+		return *archetype;
+	}
+
+	void FreeRow_(EntityLocation const& loc)
+	{
+		Entity moved = loc.archetype->FreeRow(loc.chunk, loc.row);
+		auto &moved_loc = locations_[EntityIndex(moved)];
+		if (&moved_loc != &loc)
+		{
+			moved_loc.chunk = loc.chunk;
+			moved_loc.row = loc.row;
+		}
+	}
+
+	void MoveEntity_(Entity entity, Signature signature)
+	{
+		auto &loc = locations_[EntityIndex(entity)];
+		if (loc.archetype->GetSignature() == signature)
+			return;
+
+		Archetype &dst = GetArchetype_(signature);
+		auto [chunk, row] = dst.AllocateRow(entity);
+		loc.archetype->RelocateRow(loc.chunk, loc.row, dst, chunk, row);
+		FreeRow_(loc);
+		loc = { &dst, chunk, row, entity };
+	}
+
+	// Entity manager
+	std::vector<EntityLocation> locations_;
+	std::vector<Entity> refill_entities_;
+	size_t entities_count;
+
+	// Component manager
+	std::array<ComponentInfo const*, MAX_COMPONENTS> infos_;
+
+	// Archetype manager
+	std::unordered_map<Signature, std::unique_ptr<Archetype>> archetypes_{};
+};
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "algebra.hpp"
+
+#include <span>
+
+namespace wil {
+
+// Batched vector math over contiguous arrays, processing 4 elements at a
+// time with SIMD where available. Destination spans must be as large as the
+// sources and may alias them. Aligned loads are used when every span starts
+// on a 16 bytes boundary.
+
+enum BatchPrecision
+{
+	// Square root and division, as Normalize
+	BATCH_EXACT,
+	// Approximate reciprocal square root refined by one Newton step,
+	// relative error around 1e-6
+	BATCH_FAST,
+};
+
+// dst[i] = mat * (src[i], 1), mat must be affine.
+void TransformPoints(Fmat4 const& mat, std::span<const Fvec3> src, std::span<Fvec3> dst);
+
+// dst[i] = mat * (src[i], 0), directions are not translated.
+void TransformDirections(Fmat4 const& mat, std::span<const Fvec3> src, std::span<Fvec3> dst);
+
+// dst[i] = mat * src[i]
+void TransformVectors(Fmat4 const& mat, std::span<const Fvec4> src, std::span<Fvec4> dst);
+
+// dst[i] = Normalize(src[i])
+void NormalizeBatch(std::span<const Fvec3> src, std::span<Fvec3> dst, BatchPrecision precision = BATCH_EXACT);
+
+void NormalizeBatch(std::span<const Fvec4> src, std::span<Fvec4> dst, BatchPrecision precision = BATCH_EXACT);
+
+// dst[i] = Dot(a[i], b[i])
+void DotBatch(std::span<const Fvec3> a, std::span<const Fvec3> b, std::span<float> dst);
+
+void DotBatch(std::span<const Fvec4> a, std::span<const Fvec4> b, std::span<float> dst);
+
+// Extend min and max, component wise, to contain every point.
+void MinMaxBatch(std::span<const Fvec3> points, Fvec3 &min, Fvec3 &max);
+
+// Largest squared distance from center to a point, 0 without points.
+float MaxDistanceSquaredBatch(std::span<const Fvec3> points, Fvec3 center);
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "algebra.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace wil {
+
+// Axis aligned bounding box
+struct AABB
+{
+	Fvec3 min;
+	Fvec3 max;
+};
+
+struct BoundingSphere
+{
+	Fvec3 center;
+	float radius;
+};
+
+// Half line of the points origin + t * direction, t >= 0
+struct Ray
+{
+	Fvec3 origin;
+	Fvec3 direction;
+};
+
+// Smallest box containing the points, an empty box (min > max) without
+// points
+AABB ComputeAABB(std::span<const Fvec3> points);
+
+// Sphere centered on box containing the points, the points must be inside
+// box
+BoundingSphere ComputeBoundingSphere(std::span<const Fvec3> points, AABB const& box);
+
+// Smallest box containing both boxes
+AABB Merge(AABB const& a, AABB const& b);
+
+// Sphere containing both spheres, centered on center
+BoundingSphere Merge(BoundingSphere const& a, BoundingSphere const& b, Fvec3 center);
+
+// Box containing box transformed by an affine matrix
+AABB TransformAABB(AABB const& box, Fmat4 const& mat);
+
+// Sphere containing sphere transformed by an affine matrix
+BoundingSphere TransformSphere(BoundingSphere const& sphere, Fmat4 const& mat);
+
+// Distance t along a ray where it enters box, 0 when it starts inside.
+// inv_direction is 1 / ray.direction per component. Returns false when the
+// box is missed or entered further than max_t.
+bool IntersectRay(AABB const& box, Fvec3 origin, Fvec3 inv_direction, float max_t, float &t);
+
+enum Containment
+{
+	CONTAINMENT_OUTSIDE,
+	CONTAINMENT_PARTIAL,
+	CONTAINMENT_INSIDE,
+};
+
+// Planes (a, b, c, d) bounding a view volume, a point p is inside when
+// a * p.x + b * p.y + c * p.z + d >= 0 for every plane. Planes are
+// normalized so the value is the signed distance to the plane.
+struct Frustum
+{
+	Fvec4 planes[6];
+
+	// Frustum of a projection * view matrix in world space, or of a
+	// projection * view * model matrix in object space.
+	static Frustum FromMatrix(Fmat4 const& mat);
+
+	bool Intersects(AABB const& box) const;
+
+	bool Intersects(BoundingSphere const& sphere) const;
+
+	// Whether box is outside, crossing the planes or fully inside.
+	Containment Classify(AABB const& box) const;
+};
+
+// visible[i] = frustum.Intersects(boxes[i]), testing 4 boxes at a time.
+// Returns the number of visible boxes.
+size_t CullAABBs(Frustum const& frustum, std::span<const AABB> boxes, std::span<uint8_t> visible);
+
+// visible[i] = frustum.Intersects(spheres[i]), testing 4 spheres at a time.
+// Returns the number of visible spheres.
+size_t CullSpheres(Frustum const& frustum, std::span<const BoundingSphere> spheres, std::span<uint8_t> visible);
+
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "device.hpp"
+#include "memory.hpp"
+#include "upload.hpp"
+#include <cstring>
 
 namespace wil {
 
@@ -20,8 +23,15 @@ public:
 
 	VertexBuffer &operator=(VertexBuffer &&buffer);
 
+	// Blocks until the graphics queue is idle and the copy landed, so the
+	// buffer can be rewritten while in use
     void MapData(const void* src);
 
+	// Records the copy into the batch instead of submitting it alone, the
+	// buffer is usable once the token of the batch is acquired. The caller
+	// must make sure no submitted frame still reads the buffer.
+	void MapData(const void *src, UploadBatch &batch);
+
 	VendorPtr GetVkBufferPtr_() const { return buffer_ptr_; }
 
     size_t GetSize() const { return size_; }
@@ -31,7 +41,7 @@ private:
 	Device *device_;
 
     VendorPtr buffer_ptr_;
-    VendorPtr memory_ptr_;
+    MemoryAllocation allocation_;
     size_t size_;
 };
 
@@ -51,8 +61,11 @@ public:
 
 	IndexBuffer &operator=(IndexBuffer &&buffer);
 
+	// Same as VertexBuffer::MapData
     void MapData(const unsigned* src);
 
+	void MapData(const unsigned *src, UploadBatch &batch);
+
 	VendorPtr GetVkBufferPtr_() const { return buffer_ptr_; }
 
     size_t GetSize() const { return size_; }
@@ -62,7 +75,7 @@ private:
 	Device *device_;
 
     VendorPtr buffer_ptr_;
-    VendorPtr memory_ptr_;
+    MemoryAllocation allocation_;
     size_t size_;
 };
 
@@ -84,6 +97,17 @@ public:
 
     void Update(const void* src);
 
+	// Copies size bytes at offset, visible to the device after Flush
+	void Update(size_t offset, size_t size, const void *src);
+
+	// Mapped address of size bytes at offset, written in place and flushed
+	// like an update
+	void *Map(size_t offset, size_t size);
+
+	// Makes the ranges updated since the last flush visible to the device,
+	// only non-coherent memory needs it. Update(src) flushes by itself.
+	void Flush();
+
 	VendorPtr GetVkBufferPtr_() const { return buffer_ptr_; }
 
     size_t GetSize() const { return size_; }
@@ -93,9 +117,10 @@ private:
 	Device *device_;
 
     VendorPtr buffer_ptr_;
-    VendorPtr memory_ptr_;
+    MemoryAllocation allocation_;
     size_t size_;
 	void *data_;
+	DirtyRanges dirty_;
 };
 
 class StorageBuffer
@@ -116,6 +141,12 @@ public:
 
 	void Update(const void *src);
 
+	void Update(size_t offset, size_t size, const void *src);
+
+	void *Map(size_t offset, size_t size);
+
+	void Flush();
+
 	VendorPtr GetVkBufferPtr_() const { return buffer_ptr_; }
 
 	size_t GetSize() const { return size_; }
@@ -125,9 +156,77 @@ private:
 	Device *device_;
 
     VendorPtr buffer_ptr_;
-    VendorPtr memory_ptr_;
+    MemoryAllocation allocation_;
     size_t size_;
 	void *data_;
+	DirtyRanges dirty_;
+};
+
+// Persistently mapped uniform memory rewritten every frame, split in one
+// region per frame in flight. Ranges are handed out linearly, aligned to the
+// minimum uniform buffer offset alignment of the device, and are bound
+// through an UNIFORM_BUFFER_DYNAMIC descriptor with their offset as dynamic
+// offset, so per-draw and per-pass constants need no buffer of their own.
+class DynamicUniformBuffer
+{
+public:
+
+	struct Allocation
+	{
+		// Null when the region of the frame is full
+		void *data;
+		uint32_t offset;
+	};
+
+	DynamicUniformBuffer() : buffer_ptr_(nullptr) {}
+
+	DynamicUniformBuffer(Device &device, size_t frame_size, uint32_t frame_count);
+
+	~DynamicUniformBuffer();
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(DynamicUniformBuffer);
+
+	DynamicUniformBuffer(DynamicUniformBuffer &&buffer);
+
+	DynamicUniformBuffer &operator=(DynamicUniformBuffer &&buffer);
+
+	// Rewinds the region of the frame, the GPU must be done reading it
+	void BeginFrame(uint32_t frame_index);
+
+	Allocation Allocate(size_t size);
+
+	template<class T>
+	Allocation Push(const T &value)
+	{
+		Allocation a = Allocate(sizeof(T));
+		if (a.data)
+			std::memcpy(a.data, &value, sizeof(T));
+		return a;
+	}
+
+	VendorPtr GetVkBufferPtr_() const { return buffer_ptr_; }
+
+	size_t GetFrameSize() const { return frame_size_; }
+
+	size_t GetAlignment() const { return alignment_; }
+
+	// Makes the ranges handed out since the last flush visible to the
+	// device, only non-coherent memory needs it
+	void Flush();
+
+	// Bytes handed out in the current frame
+	size_t GetUsed() const { return head_ - begin_; }
+
+private:
+
+	Device *device_;
+
+	VendorPtr buffer_ptr_;
+	MemoryAllocation allocation_;
+	size_t frame_size_, alignment_;
+	uint32_t frame_count_;
+	size_t begin_ = 0, head_ = 0, flushed_ = 0;
+	char *data_;
 };
 
 class Texture
@@ -140,6 +239,8 @@ public:
 
 	Texture(Device &dev, const void *data, size_t size, uint32_t width, uint32_t height);
 
+	Texture(Device &dev, const void *data, size_t size, uint32_t width, uint32_t height, UploadBatch &batch);
+
 	~Texture();
 
 	WIL_DELETE_COPY_AND_REASSIGNMENT(Texture);
@@ -154,12 +255,12 @@ public:
 
 private:
 
-	void Init_(Device &dev, const void *data, size_t size, uint32_t width, uint32_t height);
+	void Init_(Device &dev, const void *data, size_t size, uint32_t width, uint32_t height, UploadBatch &batch);
 
 	Device *device_;
 
 	VendorPtr image_ptr_;
-	VendorPtr memory_ptr_;
+	MemoryAllocation allocation_;
 	VendorPtr image_view_ptr_;
 	VendorPtr sampler_ptr_;
 };
@@ -183,7 +284,7 @@ private:
 	Device &device_;
 
 	VendorPtr image_ptr_;
-	VendorPtr memory_ptr_;
+	MemoryAllocation allocation_;
 	VendorPtr image_view_ptr_;
 
 	uint32_t format_;
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "core.hpp"
+#include "ecs.hpp"
+#include "bounds.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wil {
+
+// Dynamic bounding volume hierarchy of entity boxes. Leaves store the boxes
+// enlarged by a margin, so entities moving within it leave the tree as is,
+// others are removed and inserted again. Insertions pick the sibling adding
+// the least surface area and rotations keep the tree balanced, queries visit
+// O(log n) nodes plus the reported entities.
+class AABBTree
+{
+public:
+
+	static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+	AABBTree(float margin = 0.1f) : margin_(margin) {}
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(AABBTree);
+
+	// Insert entity, or move it when already present. Returns true when the
+	// tree was modified, false when box is still inside the enlarged leaf.
+	bool Update(Entity entity, AABB const& box);
+
+	void Remove(Entity entity);
+
+	void Clear();
+
+	bool Contains(Entity entity) const
+	{
+		uint32_t leaf = leaves_.Find(entity);
+		return leaf != SparseIndex::NULL_INDEX && nodes_[leaf].entity == entity;
+	}
+
+	// Enlarged box of an entity in the tree.
+	const AABB &GetBounds(Entity entity) const { return nodes_[leaves_[entity]].box; }
+
+	size_t size() const { return count_; }
+
+	// Height of the root, 0 for a single leaf.
+	int32_t GetHeight() const { return root_ == NULL_NODE ? 0 : nodes_[root_].height; }
+
+	// Invoke fn(Entity) on every entity.
+	template<typename Fn>
+	void Each(Fn &&fn) const
+	{
+		for (auto const& node : nodes_)
+			if (node.height == 0)
+				fn(node.entity);
+	}
+
+	// Invoke fn(Entity) on the entities whose box overlaps box.
+	template<typename Fn>
+	void Query(AABB const& box, Fn &&fn) const
+	{
+		Traverse_([&box](AABB const& b) {
+			return b.min.x <= box.max.x && b.max.x >= box.min.x
+				&& b.min.y <= box.max.y && b.max.y >= box.min.y
+				&& b.min.z <= box.max.z && b.max.z >= box.min.z;
+		}, fn);
+	}
+
+	// Invoke fn(Entity) on the entities whose box overlaps sphere.
+	template<typename Fn>
+	void Query(BoundingSphere const& sphere, Fn &&fn) const
+	{
+		Traverse_([&sphere](AABB const& b) {
+			float dist = 0.f;
+			for (unsigned i = 0; i < 3; ++i)
+			{
+				float d = std::max(std::max(b.min[i] - sphere.center[i], sphere.center[i] - b.max[i]), 0.f);
+				dist += d * d;
+			}
+			return dist <= sphere.radius * sphere.radius;
+		}, fn);
+	}
+
+	// Invoke fn(Entity) on the entities whose box intersects frustum.
+	// Subtrees fully inside are reported without further plane tests.
+	template<typename Fn>
+	void Query(Frustum const& frustum, Fn &&fn) const
+	{
+		if (root_ == NULL_NODE)
+			return;
+
+		std::vector<uint32_t> stack = { root_ };
+		while (!stack.empty())
+		{
+			uint32_t index = stack.back();
+			stack.pop_back();
+
+			auto const& node = nodes_[index];
+			Containment containment = frustum.Classify(node.box);
+			if (containment == CONTAINMENT_OUTSIDE)
+				continue;
+
+			if (node.height == 0)
+				fn(node.entity);
+			else if (containment == CONTAINMENT_INSIDE)
+				EachIn_(index, fn);
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	// Invoke fn(Entity, t) on the entities whose box ray enters at a
+	// distance t <= max_t, t in units of ray.direction. fn returns the new
+	// max_t, returning its exact hit distance finds the closest entity.
+	template<typename Fn>
+	void Raycast(Ray const& ray, float max_t, Fn &&fn) const
+	{
+		if (root_ == NULL_NODE)
+			return;
+
+		Fvec3 inv_direction = { 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+		std::vector<uint32_t> stack = { root_ };
+		while (!stack.empty())
+		{
+			auto const& node = nodes_[stack.back()];
+			stack.pop_back();
+
+			float t;
+			if (!IntersectRay(node.box, ray.origin, inv_direction, max_t, t))
+				continue;
+
+			if (node.height == 0)
+				max_t = fn(node.entity, t);
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+private:
+
+	struct Node
+	{
+		AABB box;
+		uint32_t parent = NULL_NODE;
+		uint32_t left = NULL_NODE;
+		uint32_t right = NULL_NODE;
+		// 0 for leaves, -1 for free nodes
+		int32_t height = -1;
+		Entity entity = NULL_ENTITY;
+	};
+
+	template<typename Overlaps, typename Fn>
+	void Traverse_(Overlaps &&overlaps, Fn &fn) const
+	{
+		if (root_ == NULL_NODE)
+			return;
+
+		std::vector<uint32_t> stack = { root_ };
+		while (!stack.empty())
+		{
+			auto const& node = nodes_[stack.back()];
+			stack.pop_back();
+
+			if (!overlaps(node.box))
+				continue;
+
+			if (node.height == 0)
+				fn(node.entity);
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	// Invoke fn(Entity) on every leaf under index.
+	template<typename Fn>
+	void EachIn_(uint32_t index, Fn &fn) const
+	{
+		std::vector<uint32_t> stack = { index };
+		while (!stack.empty())
+		{
+			auto const& node = nodes_[stack.back()];
+			stack.pop_back();
+
+			if (node.height == 0)
+				fn(node.entity);
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	uint32_t AllocateNode_();
+
+	void FreeNode_(uint32_t index);
+
+	void InsertLeaf_(uint32_t leaf);
+
+	void RemoveLeaf_(uint32_t leaf);
+
+	// Recompute the boxes and heights from index up to the root,
+	// rebalancing on the way.
+	void Refit_(uint32_t index);
+
+	// Rotate the taller child of index above it if unbalanced, returns the
+	// node now at the place of index.
+	uint32_t Balance_(uint32_t index);
+
+	float margin_;
+
+	std::vector<Node> nodes_;
+	std::vector<uint32_t> free_;
+	uint32_t root_ = NULL_NODE;
+	size_t count_ = 0;
+
+	// Leaf of every entity
+	SparseIndex leaves_;
+};
+
+}
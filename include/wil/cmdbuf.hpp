@@ -34,7 +34,10 @@ struct CmdDraw
 	void BindVertexBuffer(const VertexBuffer &buffer);
 	void BindIndexBuffer(const IndexBuffer &buffer);
 
-	void BindDescriptorSets(Pipeline &pipeline, int first_set, DescriptorSet *sets, size_t count);
+	// Dynamic offsets are consumed in set then binding order by the
+	// UNIFORM_BUFFER_DYNAMIC bindings of the sets
+	void BindDescriptorSets(Pipeline &pipeline, int first_set, DescriptorSet *sets, size_t count,
+			const uint32_t *dynamic_offsets = nullptr, size_t dynamic_count = 0);
 	void PushConstant(Pipeline &pipeline, const void* data);
 
 	void Draw(uint32_t count, uint32_t instance);
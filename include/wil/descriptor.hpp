@@ -17,6 +17,10 @@ public:
 
 	void BindUniform(uint32_t binding, UniformBuffer &buffer);
 
+	// Binding of type UNIFORM_BUFFER_DYNAMIC reading range bytes at the
+	// dynamic offset given when the set is bound
+	void BindUniformDynamic(uint32_t binding, DynamicUniformBuffer &buffer, size_t range);
+
 	void BindStorage(uint32_t binding, StorageBuffer &buffer);
 
 	void BindTexture(uint32_t binding, const Texture &texture);
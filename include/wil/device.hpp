@@ -34,6 +34,9 @@ public:
 
 	DeviceQueue GetPresentQueue() const { return present_queue_; }
 
+	// Queue of uploads, the graphics queue when no other family can copy
+	DeviceQueue GetTransferQueue() const { return transfer_queue_; }
+
 	void RecreateSwapchain(Window *win, Ivec2 fbsize, bool vsync);
 
 	VendorPtr GetVkDevicePtr_() { return device_ptr_; }
@@ -48,6 +51,12 @@ public:
 
 	VendorPtr GetVkFramebufferPtr_(uint32_t index) { return framebuffers_ptr_[index]; }
 
+	// Sub-allocator of the memory of buffers and images.
+	class MemoryAllocator &GetAllocator() { return *allocator_; }
+
+	// Mapped host memory that upload batches stage their copies in
+	class StagingRing &GetStagingRing() { return *staging_ring_; }
+
 private:
 
 	void InitDevice_(VendorPtr vkinst, VendorPtr vksurface);
@@ -57,7 +66,7 @@ private:
 	void InitFramebuffers_();
 
 	VendorPtr device_ptr_, physical_ptr_;
-	DeviceQueue graphics_queue_, present_queue_;
+	DeviceQueue graphics_queue_, present_queue_, transfer_queue_;
 
 	VendorPtr swapchain_ptr_;
 	uint32_t swapchain_format_;
@@ -66,6 +75,9 @@ private:
 
 	VendorPtr pool_ptr_;
 
+	class MemoryAllocator *allocator_;
+	class StagingRing *staging_ring_;
+
 	class DepthBuffer *depth_buffer_;
 	VendorPtr render_pass_ptr_;
 	std::vector<VendorPtr> framebuffers_ptr_;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "algebra.hpp"
+#include "log.hpp"
 
 #include <bitset>
 #include <cstdint>
@@ -8,16 +9,132 @@
 #include <unordered_map>
 #include <typeindex>
 #include <memory>
-#include <set>
+#include <array>
+#include <bit>
+#include <atomic>
+#include <span>
+#include <tuple>
+#include <mutex>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <type_traits>
 
 namespace wil {
 
 constexpr size_t MAX_COMPONENTS = 64;
 
+static_assert(MAX_COMPONENTS <= 64, "Signatures are handled as 64 bit masks");
+
 using Entity		= uint32_t;
 using ComponentType = uint8_t;
 using Signature		= std::bitset<MAX_COMPONENTS>;
 
+// An entity handle packs a 24 bit index and an 8 bit generation. The
+// generation is incremented every time an index is recycled, so handles to
+// destroyed entities can be detected with IsAlive. A registry holds at most
+// ENTITY_INDEX_MASK entities created over its lifetime, recycled indices
+// excluded, the last index is left out since it makes NULL_ENTITY.
+constexpr uint32_t ENTITY_INDEX_BITS = 24;
+constexpr Entity ENTITY_INDEX_MASK = (Entity(1) << ENTITY_INDEX_BITS) - 1;
+constexpr Entity NULL_ENTITY = UINT32_MAX;
+
+constexpr uint32_t EntityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+constexpr uint32_t EntityGeneration(Entity entity) { return entity >> ENTITY_INDEX_BITS; }
+
+constexpr Entity MakeEntity(uint32_t index, uint32_t generation)
+{
+	return (generation << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK);
+}
+
+inline ComponentType NextComponentType_()
+{
+	static std::atomic<ComponentType> counter = 0;
+	ComponentType type = counter++;
+	// Arrays indexed by type hold MAX_COMPONENTS entries
+	WIL_ASSERT(type < MAX_COMPONENTS);
+	return type;
+}
+
+// Component type of T. Assigned once on first use and shared by every
+// registry, at most MAX_COMPONENTS types can be used in a program.
+template<typename T>
+ComponentType GetComponentTypeId()
+{
+	static const ComponentType type = NextComponentType_();
+	return type;
+}
+
+// Identifies a component type in snapshots. It only depends on the type name
+// and size, so it is stable between runs of the same build.
+template<typename T>
+uint64_t GetComponentTypeKey()
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (const char *c = typeid(T).name(); *c; ++c)
+		hash = (hash ^ static_cast<uint8_t>(*c)) * 1099511628211ull;
+	return (hash ^ sizeof(T)) * 1099511628211ull;
+}
+
+// Components saved in snapshots are copied as raw bytes.
+template<typename T>
+constexpr bool IS_SNAPSHOT_COMPONENT = std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>;
+
+// Maps entities to 32 bit indices. Pages of PAGE_SIZE slots are indexed
+// directly by the entity index and allocated on first use.
+class SparseIndex
+{
+public:
+
+	static constexpr size_t PAGE_SIZE = 4096;
+	static constexpr uint32_t NULL_INDEX = UINT32_MAX;
+
+	// Index of an entity known to be present.
+	uint32_t operator[](Entity entity) const
+	{
+		uint32_t index = EntityIndex(entity);
+		return pages_[index / PAGE_SIZE][index % PAGE_SIZE];
+	}
+
+	// Index of an entity, or NULL_INDEX if absent.
+	uint32_t Find(Entity entity) const
+	{
+		uint32_t index = EntityIndex(entity);
+		size_t page = index / PAGE_SIZE;
+		return page < pages_.size() && pages_[page]
+			? pages_[page][index % PAGE_SIZE] : NULL_INDEX;
+	}
+
+	bool Contains(Entity entity) const { return Find(entity) != NULL_INDEX; }
+
+	// Slot of an entity, allocating its page if needed.
+	uint32_t &At(Entity entity)
+	{
+		uint32_t index = EntityIndex(entity);
+		size_t page = index / PAGE_SIZE;
+		if (page >= pages_.size())
+			pages_.resize(page + 1);
+		if (!pages_[page])
+		{
+			pages_[page].reset(new uint32_t[PAGE_SIZE]);
+			std::fill_n(pages_[page].get(), PAGE_SIZE, NULL_INDEX);
+		}
+		return pages_[page][index % PAGE_SIZE];
+	}
+
+	// Slot of an entity whose page is known to be allocated.
+	uint32_t &Slot(Entity entity)
+	{
+		uint32_t index = EntityIndex(entity);
+		return pages_[index / PAGE_SIZE][index % PAGE_SIZE];
+	}
+
+private:
+	std::vector<std::unique_ptr<uint32_t[]>> pages_;
+};
+
 class BaseComponentArray
 {
 public:
@@ -28,12 +145,40 @@ public:
 
 	virtual void EntityDestroyed(Entity entity) = 0;
 
+	virtual void EntitiesDestroyed(std::span<const Entity> entities)
+	{
+		for (Entity entity : entities)
+			EntityDestroyed(entity);
+	}
+
+	virtual void Clear() = 0;
+
+	// Dense arrays of the component as saved in snapshots. The key is 0 for
+	// components that cannot be saved.
+	struct SnapshotData
+	{
+		uint64_t key = 0;
+		uint32_t size = 0;
+		std::span<const Entity> entities;
+		const void *data = nullptr;
+	};
+
+	virtual SnapshotData GetSnapshotData() const { return {}; }
+
+	// Replace the content of the array with components copied from data.
+	virtual void LoadSnapshot(std::span<const Entity> entities, const void *data, uint32_t version) {}
+
 	ComponentType GetType() const { return type_; }
 
 private:
 	ComponentType type_;
 };
 
+// Component array indexing its dense storage through a paged sparse set,
+// so lookups are two array reads and inserts do not allocate per entity.
+// Every component keeps the versions it was added and last modified at,
+// and modifications are logged in version order so the entities changed
+// since a version are found without scanning the whole array.
 template<typename T>
 class ComponentArray : public BaseComponentArray
 {
@@ -41,11 +186,250 @@ public:
 
 	ComponentArray(ComponentType type) : BaseComponentArray(type) {};
 
-	void InsertData(Entity entity, T&& component)
+	void InsertData(Entity entity, T&& component, uint32_t version = 0)
+	{
+		sparse_.At(entity) = static_cast<uint32_t>(components_.size());
+		components_.emplace_back(std::forward<T>(component));
+		index_to_entity.emplace_back(entity);
+		added_.push_back(version);
+		changed_.push_back(version);
+		logged_.push_back(Log_(entity, version));
+	}
+
+	void RemoveData(Entity entity)
+	{
+		uint32_t i = sparse_[entity];
+		uint32_t last = static_cast<uint32_t>(components_.size() - 1);
+
+		if (i != last)
+		{
+			Entity moved = index_to_entity[last];
+			components_[i] = std::move(components_[last]);
+			index_to_entity[i] = moved;
+			added_[i] = added_[last];
+			changed_[i] = changed_[last];
+			logged_[i] = logged_[last];
+			sparse_.Slot(moved) = i;
+		}
+
+		components_.pop_back();
+		index_to_entity.pop_back();
+		added_.pop_back();
+		changed_.pop_back();
+		logged_.pop_back();
+		sparse_.Slot(entity) = SparseIndex::NULL_INDEX;
+	}
+
+	T& GetData(Entity entity)
+	{
+		return components_[sparse_[entity]];
+	}
+
+	// Mutable access marking the component as changed at version.
+	T& Modify(Entity entity, uint32_t version)
+	{
+		uint32_t i = sparse_[entity];
+		if (changed_[i] != version)
+		{
+			changed_[i] = version;
+			logged_[i] = Log_(entity, version);
+		}
+		return components_[i];
+	}
+
+	uint32_t GetAddedVersion(Entity entity) const { return added_[sparse_[entity]]; }
+	uint32_t GetChangedVersion(Entity entity) const { return changed_[sparse_[entity]]; }
+
+	// Invoke fn(Entity, T&) on every component added or modified after
+	// version since. Components must not be added, removed or modified
+	// from within fn.
+	template<class Fn>
+	void EachChanged(uint32_t since, Fn &&fn)
+	{
+		// Part of the changes were dropped from the log
+		if (since < log_floor_)
+		{
+			for (size_t i = 0; i < components_.size(); ++i)
+				if (changed_[i] > since)
+					fn(index_to_entity[i], components_[i]);
+			return;
+		}
+
+		auto first = std::upper_bound(log_.begin(), log_.end(), since,
+				[](uint32_t version, auto const& change) { return version < change.version; });
+
+		for (size_t j = first - log_.begin(); j < log_.size(); ++j)
+		{
+			uint32_t i = sparse_.Find(log_[j].entity);
+			// Skip removed components and changes logged again later
+			if (i != SparseIndex::NULL_INDEX && logged_[i] == log_start_ + j)
+				fn(index_to_entity[i], components_[i]);
+		}
+	}
+
+	bool HasData(Entity entity) const
+	{
+		return sparse_.Contains(entity);
+	}
+
+	void EntityDestroyed(Entity entity) override
+	{
+		if (HasData(entity))
+			RemoveData(entity);
+	}
+
+	// Swap removing many entities scatters the dense arrays, compact them
+	// in a single pass instead.
+	void EntitiesDestroyed(std::span<const Entity> entities) override
+	{
+		if (entities.size() * 4 < components_.size())
+		{
+			for (Entity entity : entities)
+				EntityDestroyed(entity);
+			return;
+		}
+
+		for (Entity entity : entities)
+			if (HasData(entity))
+				sparse_.Slot(entity) = SparseIndex::NULL_INDEX;
+
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < index_to_entity.size(); ++i)
+		{
+			Entity entity = index_to_entity[i];
+			if (!HasData(entity))
+				continue;
+			if (i != count)
+			{
+				components_[count] = std::move(components_[i]);
+				index_to_entity[count] = entity;
+				added_[count] = added_[i];
+				changed_[count] = changed_[i];
+				logged_[count] = logged_[i];
+			}
+			sparse_.Slot(entity) = count++;
+		}
+
+		components_.erase(components_.begin() + count, components_.end());
+		index_to_entity.resize(count);
+		added_.resize(count);
+		changed_.resize(count);
+		logged_.resize(count);
+	}
+
+	void Reserve(size_t capacity)
+	{
+		components_.reserve(capacity);
+		index_to_entity.reserve(capacity);
+		added_.reserve(capacity);
+		changed_.reserve(capacity);
+		logged_.reserve(capacity);
+	}
+
+	void Clear() override
+	{
+		for (Entity entity : index_to_entity)
+			sparse_.Slot(entity) = SparseIndex::NULL_INDEX;
+
+		components_.clear();
+		index_to_entity.clear();
+		added_.clear();
+		changed_.clear();
+		logged_.clear();
+
+		// Keep log positions unique so stale positions never match
+		log_start_ += log_.size();
+		log_.clear();
+	}
+
+	SnapshotData GetSnapshotData() const override
+	{
+		if constexpr (IS_SNAPSHOT_COMPONENT<T>)
+			return { GetComponentTypeKey<T>(), sizeof(T), index_to_entity, components_.data() };
+		return {};
+	}
+
+	// Loaded components are added at version and not logged, queries since
+	// an older version scan the array.
+	void LoadSnapshot(std::span<const Entity> entities, const void *data, uint32_t version) override
+	{
+		if constexpr (IS_SNAPSHOT_COMPONENT<T>)
+		{
+			Clear();
+
+			size_t count = entities.size();
+			components_.resize(count);
+			std::memcpy(components_.data(), data, count * sizeof(T));
+			index_to_entity.assign(entities.begin(), entities.end());
+			added_.assign(count, version);
+			changed_.assign(count, version);
+			logged_.assign(count, SIZE_MAX);
+			log_floor_ = version;
+
+			for (uint32_t i = 0; i < count; ++i)
+				sparse_.At(entities[i]) = i;
+		}
+	}
+
+	// Dense arrays, the i-th component belongs to the i-th entity.
+	std::span<T> GetDataArray() { return components_; }
+	std::span<const Entity> GetEntities() const { return index_to_entity; }
+
+private:
+
+	struct Change_
+	{
+		Entity entity;
+		uint32_t version;
+	};
+
+	// Append a change to the log and return its position. When the log
+	// outgrows the array its oldest half is dropped.
+	size_t Log_(Entity entity, uint32_t version)
+	{
+		if (log_.size() >= 2 * std::max<size_t>(components_.size(), 1024))
+		{
+			size_t dropped = log_.size() / 2;
+			log_floor_ = log_[dropped - 1].version;
+			log_.erase(log_.begin(), log_.begin() + dropped);
+			log_start_ += dropped;
+		}
+
+		log_.push_back({entity, version});
+		return log_start_ + log_.size() - 1;
+	}
+
+	std::vector<T> components_;
+	SparseIndex sparse_;
+	std::vector<Entity> index_to_entity;
+
+	// Change tracking, parallel to components_
+	std::vector<uint32_t> added_, changed_;
+	std::vector<size_t> logged_;
+
+	// Changes sorted by version. log_start_ is the position of log_[0] since
+	// the first change, changes up to log_floor_ may have been dropped.
+	std::vector<Change_> log_;
+	size_t log_start_ = 0;
+	uint32_t log_floor_ = 0;
+};
+
+// Component array indexing its dense storage through a hash map.
+// Kept as an alternative storage policy of BasicRegistry for comparison.
+template<typename T>
+class MapComponentArray : public BaseComponentArray
+{
+public:
+
+	MapComponentArray(ComponentType type) : BaseComponentArray(type) {};
+
+	void InsertData(Entity entity, T&& component, uint32_t version = 0)
 	{
 		entity_to_index_[entity] = components_.size();
 		components_.emplace_back(std::forward<T>(component));
 		index_to_entity.emplace_back(entity);
+		added_.push_back(version);
+		changed_.push_back(version);
 	}
 
 	void RemoveData(Entity entity)
@@ -56,10 +440,14 @@ public:
 		components_[i] = components_[last];
 		entity_to_index_.at(index_to_entity[last]) = i;
 		index_to_entity[i] = index_to_entity[last];
+		added_[i] = added_[last];
+		changed_[i] = changed_[last];
 
 		components_.pop_back();
 		entity_to_index_.erase(entity);
 		index_to_entity.pop_back();
+		added_.pop_back();
+		changed_.pop_back();
 	}
 
 	T& GetData(Entity entity)
@@ -67,39 +455,279 @@ public:
 		return components_[entity_to_index_.at(entity)];
 	}
 
+	T& Modify(Entity entity, uint32_t version)
+	{
+		size_t i = entity_to_index_.at(entity);
+		changed_[i] = version;
+		return components_[i];
+	}
+
+	uint32_t GetAddedVersion(Entity entity) const { return added_[entity_to_index_.at(entity)]; }
+	uint32_t GetChangedVersion(Entity entity) const { return changed_[entity_to_index_.at(entity)]; }
+
+	// Changes are not logged, the whole array is scanned.
+	template<class Fn>
+	void EachChanged(uint32_t since, Fn &&fn)
+	{
+		for (size_t i = 0; i < components_.size(); ++i)
+			if (changed_[i] > since)
+				fn(index_to_entity[i], components_[i]);
+	}
+
+	bool HasData(Entity entity) const
+	{
+		return entity_to_index_.count(entity);
+	}
+
 	void EntityDestroyed(Entity entity) override
 	{
 		if (entity_to_index_.count(entity))
 			RemoveData(entity);
 	}
 
+	void Reserve(size_t capacity)
+	{
+		components_.reserve(capacity);
+		entity_to_index_.reserve(capacity);
+		index_to_entity.reserve(capacity);
+		added_.reserve(capacity);
+		changed_.reserve(capacity);
+	}
+
+	void Clear() override
+	{
+		components_.clear();
+		entity_to_index_.clear();
+		index_to_entity.clear();
+		added_.clear();
+		changed_.clear();
+	}
+
+	SnapshotData GetSnapshotData() const override
+	{
+		if constexpr (IS_SNAPSHOT_COMPONENT<T>)
+			return { GetComponentTypeKey<T>(), sizeof(T), index_to_entity, components_.data() };
+		return {};
+	}
+
+	void LoadSnapshot(std::span<const Entity> entities, const void *data, uint32_t version) override
+	{
+		if constexpr (IS_SNAPSHOT_COMPONENT<T>)
+		{
+			Clear();
+			Reserve(entities.size());
+
+			for (size_t i = 0; i < entities.size(); ++i)
+			{
+				T component;
+				std::memcpy(&component, static_cast<const std::byte*>(data) + i * sizeof(T), sizeof(T));
+				InsertData(entities[i], std::move(component), version);
+			}
+		}
+	}
+
+	// Dense arrays, the i-th component belongs to the i-th entity.
+	std::span<T> GetDataArray() { return components_; }
+	std::span<const Entity> GetEntities() const { return index_to_entity; }
+
 private:
 
 	std::vector<T> components_;
 	std::unordered_map<Entity, size_t> entity_to_index_;
 	std::vector<Entity> index_to_entity;
+	std::vector<uint32_t> added_, changed_;
 };
 
+// Filters of Registry::Each. The component T is still passed to fn, but only
+// for entities whose T was modified (Changed) or added (Added) after the
+// version given to Each.
+template<typename T> struct Changed {};
+template<typename T> struct Added {};
+
+template<typename T>
+struct ComponentFilter_
+{
+	using Type = T;
+	static constexpr bool FILTERED = false;
+
+	template<class A>
+	static bool Passes(A const&, Entity, uint32_t) { return true; }
+};
+
+template<typename T>
+struct ComponentFilter_<Changed<T>>
+{
+	using Type = T;
+	static constexpr bool FILTERED = true;
+
+	template<class A>
+	static bool Passes(A const& array, Entity entity, uint32_t since) { return array.GetChangedVersion(entity) > since; }
+};
+
+template<typename T>
+struct ComponentFilter_<Added<T>>
+{
+	using Type = T;
+	static constexpr bool FILTERED = true;
+
+	template<class A>
+	static bool Passes(A const& array, Entity entity, uint32_t since) { return array.GetAddedVersion(entity) > since; }
+};
+
+template<typename T>
+using FilteredComponent_ = typename ComponentFilter_<T>::Type;
+
+template<class... Ts>
+constexpr size_t FirstFilter_()
+{
+	constexpr bool filtered[] = { ComponentFilter_<Ts>::FILTERED... };
+	for (size_t i = 0; i < sizeof...(Ts); ++i)
+		if (filtered[i])
+			return i;
+	return sizeof...(Ts);
+}
+
+// Entities whose signature contains pass, stored contiguously. Order is not
+// stable: removing an entity moves the last one into its place.
 struct EntityView
 {
 	Signature pass;
-	std::set<Entity> set;
+	std::vector<Entity> entities;
+
+	// Incremented whenever entities are inserted or removed.
+	size_t revision = 0;
+
+	auto begin() const { return entities.begin(); }
+	auto end() const { return entities.end(); }
+
+	size_t size() const { return entities.size(); }
+
+	bool Contains(Entity entity) const { return index_.Contains(entity); }
+
+	// Position of an entity in entities, SparseIndex::NULL_INDEX if absent.
+	uint32_t Find(Entity entity) const { return index_.Find(entity); }
+
+	void Insert_(Entity entity)
+	{
+		uint32_t &slot = index_.At(entity);
+		if (slot != SparseIndex::NULL_INDEX)
+			return;
+		slot = static_cast<uint32_t>(entities.size());
+		entities.push_back(entity);
+		++revision;
+	}
+
+	void Erase_(Entity entity)
+	{
+		uint32_t i = index_.Find(entity);
+		if (i == SparseIndex::NULL_INDEX)
+			return;
+		Entity moved = entities.back();
+		entities[i] = moved;
+		index_.Slot(moved) = i;
+		entities.pop_back();
+		index_.Slot(entity) = SparseIndex::NULL_INDEX;
+		++revision;
+	}
+
+	void Clear_()
+	{
+		for (Entity entity : entities)
+			index_.Slot(entity) = SparseIndex::NULL_INDEX;
+		if (!entities.empty())
+			++revision;
+		entities.clear();
+	}
+
+	void InsertBulk_(std::span<const Entity> added)
+	{
+		entities.reserve(entities.size() + added.size());
+		for (Entity entity : added)
+			Insert_(entity);
+	}
+
+	// Entities not in the view are ignored. Many removals compact the view
+	// in one pass, keeping the order of the remaining entities.
+	void EraseBulk_(std::span<const Entity> removed)
+	{
+		if (removed.size() * 4 < entities.size())
+		{
+			for (Entity entity : removed)
+				Erase_(entity);
+			return;
+		}
+
+		for (Entity entity : removed)
+			if (index_.Contains(entity))
+				index_.Slot(entity) = SparseIndex::NULL_INDEX;
+
+		uint32_t count = 0;
+		for (Entity entity : entities)
+			if (index_.Contains(entity))
+			{
+				index_.Slot(entity) = count;
+				entities[count++] = entity;
+			}
+		if (count != entities.size())
+			++revision;
+		entities.resize(count);
+	}
+
+private:
+	SparseIndex index_;
 };
 
 class System
 {
 public:
 
-	System(class Registry &registry) {}
+	template<class R>
+	System(R &registry) {}
 
 	virtual ~System() = default;
+
+	// Called once per SystemScheduler::Run, possibly from a worker thread.
+	virtual void Update(float elapsed) {}
+
+	// Components read or written by Update.
+	Signature GetReads() const { return reads_; }
+	Signature GetWrites() const { return writes_; }
+
+protected:
+
+	// Declare components only read by Update.
+	template<class... Ts, class R>
+	void Reads(R &registry)
+	{
+		(registry.template RegisterComponent<Ts>(), ...);
+		(reads_.set(registry.template GetComponentType<Ts>(), true), ...);
+	}
+
+	// Declare components modified by Update.
+	template<class... Ts, class R>
+	void Writes(R &registry)
+	{
+		(registry.template RegisterComponent<Ts>(), ...);
+		(writes_.set(registry.template GetComponentType<Ts>(), true), ...);
+	}
+
+private:
+	Signature reads_, writes_;
 };
 
-class Registry
+template<class R>
+class BasicRegistryCommandBuffer;
+
+struct RegistrySnapshot_;
+
+// Storage is the component array template used for every component type,
+// e.g. ComponentArray (paged sparse set) or MapComponentArray (hash map).
+template<template<class> class Storage = ComponentArray>
+class BasicRegistry
 {
 public:
 
-	Registry(size_t entities_reserve = 1000) : entities_count(0)
+	BasicRegistry(size_t entities_reserve = 1000) : entities_count(0), next_entity_(0), version_(1)
 	{
 		signatures_.reserve(entities_reserve);
 	}
@@ -109,31 +737,107 @@ public:
 	{
 		++entities_count;
 
+		Entity e;
 		if (refill_entities_.empty())
 		{
-			Entity e = signatures_.size();
-			signatures_.push_back(0);
-			return e;
+			e = next_entity_++;
+			WIL_ASSERT(e < ENTITY_INDEX_MASK);
+			if (e >= signatures_.size())
+				GrowEntities_(e + 1);
 		}
 		else
 		{
-			Entity e = refill_entities_.back();
+			e = refill_entities_.back();
 			refill_entities_.pop_back();
-			return e;
 		}
+
+		handles_[EntityIndex(e)] = e;
+		return e;
+	}
+
+	// Create count entities, each with a copy of components. Component
+	// arrays and views are updated once for all of them.
+	template<class... Ts>
+	std::vector<Entity> CreateEntities(size_t count, const Ts&... components)
+	{
+		std::vector<Entity> entities(count);
+
+		size_t reused = std::min(count, refill_entities_.size());
+		std::copy(refill_entities_.end() - reused, refill_entities_.end(), entities.begin());
+		refill_entities_.resize(refill_entities_.size() - reused);
+
+		Entity first = next_entity_.fetch_add(static_cast<Entity>(count - reused));
+		WIL_ASSERT(size_t(first) + (count - reused) <= ENTITY_INDEX_MASK);
+		std::iota(entities.begin() + reused, entities.end(), first);
+		if (first + (count - reused) > signatures_.size())
+			GrowEntities_(first + (count - reused));
+
+		Signature signature;
+		(signature.set(GetComponentType<Ts>(), true), ...);
+
+		for (Entity e : entities)
+		{
+			handles_[EntityIndex(e)] = e;
+			signatures_[EntityIndex(e)] = signature;
+		}
+		entities_count += count;
+
+		(RegisterComponent<Ts>(), ...);
+		(InsertCopies_(GetComponentArray<Ts>(), entities, components), ...);
+
+		for (EntityView *view : entity_views_)
+			if (view->pass.any() && (signature & view->pass) == view->pass)
+				view->InsertBulk_(entities);
+
+		return entities;
 	}
 
+	// Destroying a stale or already destroyed entity does nothing.
 	void DestroyEntity(Entity entity)
 	{
-		signatures_[entity].reset();
-		refill_entities_.push_back(entity);
-		--entities_count;
+		if (!IsAlive(entity))
+			return;
 
-		for (auto const& [_, component] : component_arrays_)
-			component->EntityDestroyed(entity);
+		uint32_t index = EntityIndex(entity);
+		Signature signature = signatures_[index];
+		FreeEntity_(entity);
 
-		for (auto const& view : entity_views_)
-			view->set.erase(entity);
+		for (uint64_t bits = signature.to_ullong(); bits; bits &= bits - 1)
+			component_arrays_[std::countr_zero(bits)]->EntityDestroyed(entity);
+
+		UpdateEntityViews_(entity, signature);
+	}
+
+	// Destroy the alive entities among entities. Every component array and
+	// view is updated once, with the destroyed entities it contains.
+	void DestroyEntities(std::span<const Entity> entities)
+	{
+		std::array<std::vector<Entity>, MAX_COMPONENTS> destroyed;
+
+		for (Entity entity : entities)
+		{
+			if (!IsAlive(entity))
+				continue;
+
+			for (uint64_t bits = signatures_[EntityIndex(entity)].to_ullong(); bits; bits &= bits - 1)
+				destroyed[std::countr_zero(bits)].push_back(entity);
+			FreeEntity_(entity);
+		}
+
+		for (size_t type = 0; type < MAX_COMPONENTS; ++type)
+			if (!destroyed[type].empty())
+				component_arrays_[type]->EntitiesDestroyed(destroyed[type]);
+
+		for (EntityView *view : entity_views_)
+			if (view->pass.any())
+				view->EraseBulk_(destroyed[std::countr_zero(view->pass.to_ullong())]);
+	}
+
+	// False for handles of destroyed entities, even if their index is reused.
+	bool IsAlive(Entity entity) const
+	{
+		uint32_t index = EntityIndex(entity);
+		return index < handles_.size() && handles_[index] == entity;
 	}
 
 
@@ -141,10 +845,9 @@ public:
 	template<typename T>
 	void RegisterComponent()
 	{
-		auto i = std::type_index(typeid(T));
-		if (!component_arrays_.count(i))
-			component_arrays_[i]
-				= std::make_unique<ComponentArray<T>>(static_cast<ComponentType>(component_arrays_.size()));
+		ComponentType type = GetComponentType<T>();
+		if (!component_arrays_[type])
+			component_arrays_[type] = std::make_unique<Storage<T>>(type);
 	}
 
 	template<class... Ts>
@@ -152,19 +855,13 @@ public:
 	{
 		(RegisterComponent<std::remove_reference_t<Ts>>(), ...);
 		(GetComponentArray<std::remove_reference_t<Ts>>()
-		 .InsertData(entity, std::forward<std::remove_reference_t<Ts>>(components)), ...);
+		 .InsertData(entity, std::forward<std::remove_reference_t<Ts>>(components), version_), ...);
 
-		auto signature = signatures_[entity];
-		(signature.set(GetComponentType<Ts>(), true), ...);
-		signatures_[entity] = signature;
+		Signature changed;
+		(changed.set(GetComponentType<Ts>(), true), ...);
+		signatures_[EntityIndex(entity)] |= changed;
 
-		for (auto view : entity_views_)
-		{
-			if ((signature & view->pass) == view->pass)
-				view->set.insert(entity);
-			else
-				view->set.erase(entity);
-		}
+		UpdateEntityViews_(entity, changed);
 	}
 
 	template<class... Ts>
@@ -172,25 +869,30 @@ public:
 	{
 		(GetComponentArray<Ts>().RemoveData(entity), ...);
 
-		auto signature = signatures_[entity];
-		(signature.set(GetComponentType<Ts>(), false), ...);
-		signatures_[entity] = signature;
+		Signature changed;
+		(changed.set(GetComponentType<Ts>(), true), ...);
+		signatures_[EntityIndex(entity)] &= ~changed;
 
-		for (auto view : entity_views_)
-		{
-			if ((signature & view->pass) == view->pass)
-				view->set.insert(entity);
-			else
-				view->set.erase(entity);
-		}
+		UpdateEntityViews_(entity, changed);
 	}
 
+	// Untracked access, as GetComponents and Each. Writes through it are not
+	// seen by Changed<T> filters, so components consumed incrementally, like
+	// the TransformComponent of TransformHierarchy, must be written through
+	// ModifyComponent.
 	template<typename T>
 	T& GetComponent(Entity entity)
 	{
 		return GetComponentArray<T>().GetData(entity);
 	}
 
+	// Same as GetComponent, but marks the component as changed.
+	template<typename T>
+	T& ModifyComponent(Entity entity)
+	{
+		return GetComponentArray<T>().Modify(entity, version_);
+	}
+
 	template<class... Ts>
 	std::tuple<Ts&...> GetComponents(Entity entity)
 	{
@@ -200,29 +902,107 @@ public:
 	template<class... Ts>
 	bool HasComponents(Entity entity)
 	{
-		return (signatures_[entity].test(GetComponentType<Ts>()) && ...);
+		return (signatures_[EntityIndex(entity)].test(GetComponentType<Ts>()) && ...);
 	}
 
 	template<typename T>
-	ComponentType GetComponentType() const
+	static ComponentType GetComponentType()
+	{
+		return GetComponentTypeId<T>();
+	}
+
+	// Invoke fn(Entity, Ts&...) on every entity having all components Ts.
+	// Component arrays are resolved once, then the smallest one is walked.
+	// Entities must not be created, destroyed or changed from within fn.
+	template<class... Ts, class Fn>
+	void Each(Fn &&fn)
+	{
+		(RegisterComponent<Ts>(), ...);
+
+		if constexpr (sizeof...(Ts) == 1)
+		{
+			auto &array = GetComponentArray<Ts...>();
+			auto entities = array.GetEntities();
+			auto data = array.GetDataArray();
+			for (size_t i = 0; i < entities.size(); ++i)
+				fn(entities[i], data[i]);
+		}
+		else
+		{
+			std::tuple<Storage<Ts>&...> arrays = { GetComponentArray<Ts>()... };
+
+			Signature pass;
+			(pass.set(GetComponentType<Ts>(), true), ...);
+
+			std::array<std::span<const Entity>, sizeof...(Ts)> lists = {
+				std::get<Storage<Ts>&>(arrays).GetEntities()... };
+			auto entities = *std::min_element(lists.begin(), lists.end(),
+					[](auto a, auto b) { return a.size() < b.size(); });
+
+			for (Entity e : entities)
+				if ((signatures_[EntityIndex(e)] & pass) == pass)
+					fn(e, std::get<Storage<Ts>&>(arrays).GetData(e)...);
+		}
+	}
+
+	// Invoke fn(Entity, Cs&...) on every entity having all components Cs,
+	// where Ts are components or Changed<C> and Added<C> filters comparing
+	// to version since. Iteration is driven by the change log of the first
+	// filtered component, so its cost follows the number of changes.
+	template<class... Ts, class Fn>
+	void Each(uint32_t since, Fn &&fn)
 	{
-		return component_arrays_.at(std::type_index(typeid(T)))->GetType();
+		static_assert(FirstFilter_<Ts...>() < sizeof...(Ts), "Each needs a Changed or Added filter");
+		EachFiltered_<Ts...>(since, nullptr, fn);
 	}
 
+	// Same, restricted to the entities of view. Without filters the view is
+	// walked entirely.
+	template<class... Ts, class Fn>
+	void Each(EntityView const& view, uint32_t since, Fn &&fn)
+	{
+		EachFiltered_<Ts...>(since, &view, fn);
+	}
+
+	// Version stamped on components added or modified from now on.
+	uint32_t GetVersion() const { return version_; }
+
+	// Start a new version and return the previous one. Systems tick once
+	// per run, before querying the changes since the version they got on
+	// their previous run.
+	uint32_t Tick() { return version_++; }
+
 	template<class... Ts>
 	void RegisterEntityView(EntityView &view)
 	{
 		(RegisterComponent<Ts>(), ...);
 		(view.pass.set(GetComponentType<Ts>(), true), ...);
 		entity_views_.emplace_back(&view);
+
+		for (uint64_t bits = view.pass.to_ullong(); bits; bits &= bits - 1)
+			views_by_component_[std::countr_zero(bits)].push_back(&view);
+
+		// Entities created before the view was registered
+		for (size_t i = 0; i < signatures_.size() && view.pass.any(); ++i)
+			if (handles_[i] != NULL_ENTITY && (signatures_[i] & view.pass) == view.pass)
+				view.Insert_(handles_[i]);
 	}
 
 	template<class T, class... Ts>
 	T &RegisterSystem(Ts&&... args)
 	{
 		auto i = std::type_index(typeid(T));
-		systems_[i] = std::make_unique<T>(*this, std::forward<Ts>(args)...);
-		return *static_cast<T*>(systems_.at(i).get());
+		auto system = std::make_unique<T>(*this, std::forward<Ts>(args)...);
+
+		auto &slot = systems_[i];
+		auto it = std::find(system_order_.begin(), system_order_.end(), slot.get());
+		if (it != system_order_.end())
+			*it = system.get();
+		else
+			system_order_.push_back(system.get());
+
+		slot = std::move(system);
+		return *static_cast<T*>(slot.get());
 	}
 
 	template<class T>
@@ -231,34 +1011,372 @@ public:
 		return *static_cast<T*>(systems_.at(std::type_index(typeid(T))).get());
 	}
 
+	// Apply the commands recorded in buffer and clear it. Commands are sorted
+	// by entity, so each entity is changed and its views revisited only once.
+	void Playback(BasicRegistryCommandBuffer<BasicRegistry> &buffer)
+	{
+		using CommandBuffer = BasicRegistryCommandBuffer<BasicRegistry>;
+		auto &commands = buffer.commands_;
+
+		std::stable_sort(commands.begin(), commands.end(), [](auto const& a, auto const& b) {
+			return EntityIndex(a.entity) != EntityIndex(b.entity)
+				? EntityIndex(a.entity) < EntityIndex(b.entity) : a.entity < b.entity;
+		});
+
+		if (next_entity_ > signatures_.size())
+			GrowEntities_(next_entity_);
+
+		for (size_t i = 0; i < commands.size();)
+		{
+			Entity entity = commands[i].entity;
+			uint32_t index = EntityIndex(entity);
+
+			// Commands recorded with stale handles are dropped
+			if (commands[i].type != CommandBuffer::CREATE_ && !IsAlive(entity))
+			{
+				while (i < commands.size() && commands[i].entity == entity)
+					++i;
+				continue;
+			}
+
+			Signature old = signatures_[index];
+			Signature signature = old;
+			bool destroyed = false;
+
+			for (; i < commands.size() && commands[i].entity == entity; ++i)
+			{
+				auto &cmd = commands[i];
+				if (destroyed)
+					continue;
+
+				switch (cmd.type)
+				{
+					case CommandBuffer::CREATE_:
+						handles_[index] = entity;
+						++entities_count;
+						break;
+
+					case CommandBuffer::DESTROY_:
+						for (uint64_t bits = signature.to_ullong(); bits; bits &= bits - 1)
+							component_arrays_[std::countr_zero(bits)]->EntityDestroyed(entity);
+						signature.reset();
+						FreeEntity_(entity);
+						destroyed = true;
+						break;
+
+					case CommandBuffer::ADD_:
+						cmd.insert(*this, entity, cmd.payload);
+						cmd.payload = nullptr;
+						signature |= cmd.components;
+						break;
+
+					case CommandBuffer::REMOVE_:
+						for (uint64_t bits = (signature & cmd.components).to_ullong(); bits; bits &= bits - 1)
+							component_arrays_[std::countr_zero(bits)]->EntityDestroyed(entity);
+						signature &= ~cmd.components;
+						break;
+				}
+			}
+
+			signatures_[index] = signature;
+			UpdateEntityViews_(entity, old ^ signature);
+		}
+
+		buffer.Clear_();
+	}
+
+	// Systems in registration order.
+	const std::vector<System*> &GetSystems() const { return system_order_; }
+
 private:
 
+	// Re-evaluate the membership of an entity in views watching any of the
+	// changed components. A view watching several changed components is
+	// only visited from the lowest of them.
+	void UpdateEntityViews_(Entity entity, Signature changed)
+	{
+		Signature signature = signatures_[EntityIndex(entity)];
+		uint64_t mask = changed.to_ullong();
+
+		for (uint64_t bits = mask; bits; bits &= bits - 1)
+		{
+			int bit = std::countr_zero(bits);
+			for (EntityView *view : views_by_component_[bit])
+			{
+				if (std::countr_zero(view->pass.to_ullong() & mask) != bit)
+					continue;
+				if ((signature & view->pass) == view->pass)
+					view->Insert_(entity);
+				else
+					view->Erase_(entity);
+			}
+		}
+	}
+
+	void GrowEntities_(size_t count)
+	{
+		signatures_.resize(count);
+		handles_.resize(count, NULL_ENTITY);
+	}
+
+	// Release the index of an alive entity, its next handle gets a new generation.
+	void FreeEntity_(Entity entity)
+	{
+		uint32_t index = EntityIndex(entity);
+		signatures_[index].reset();
+		handles_[index] = NULL_ENTITY;
+		refill_entities_.push_back(MakeEntity(index, EntityGeneration(entity) + 1));
+		--entities_count;
+	}
+
 	template<typename T>
-	ComponentArray<T> &GetComponentArray()
+	void InsertCopies_(Storage<T> &array, std::span<const Entity> entities, const T &component)
 	{
-		return *static_cast<ComponentArray<T>*>(
-				component_arrays_.at(std::type_index(typeid(T))).get());
+		array.Reserve(array.GetEntities().size() + entities.size());
+		for (Entity entity : entities)
+			array.InsertData(entity, T(component), version_);
 	}
 
-	// Entity manager
+	template<class... Ts, class Fn>
+	void EachFiltered_(uint32_t since, EntityView const* view, Fn &fn)
+	{
+		(RegisterComponent<FilteredComponent_<Ts>>(), ...);
+		std::tuple<Storage<FilteredComponent_<Ts>>&...> arrays = { GetComponentArray<FilteredComponent_<Ts>>()... };
+
+		Signature pass;
+		(pass.set(GetComponentType<FilteredComponent_<Ts>>(), true), ...);
+
+		auto visit = [&](Entity e)
+		{
+			if ((signatures_[EntityIndex(e)] & pass) != pass || (view && !view->Contains(e)))
+				return;
+			if ((ComponentFilter_<Ts>::Passes(std::get<Storage<FilteredComponent_<Ts>>&>(arrays), e, since) && ...))
+				fn(e, std::get<Storage<FilteredComponent_<Ts>>&>(arrays).GetData(e)...);
+		};
+
+		constexpr size_t first = FirstFilter_<Ts...>();
+		if constexpr (first < sizeof...(Ts))
+			std::get<first>(arrays).EachChanged(since, [&](Entity e, auto&) { visit(e); });
+		else
+			for (Entity e : *view)
+				visit(e);
+	}
+
+	friend class BasicRegistryCommandBuffer<BasicRegistry>;
+	friend struct RegistrySnapshot_;
+
+	// Thread safe, the entity is only usable once created by a playback.
+	Entity ReserveEntity_()
+	{
+		Entity e = next_entity_++;
+		WIL_ASSERT(e < ENTITY_INDEX_MASK);
+		return e;
+	}
+
+	// Give back a reserved entity that was never played back, its index is
+	// refilled with a new generation.
+	void ReleaseEntity_(Entity entity)
+	{
+		uint32_t index = EntityIndex(entity);
+		if (index >= signatures_.size())
+			GrowEntities_(index + 1);
+		refill_entities_.push_back(MakeEntity(index, EntityGeneration(entity) + 1));
+	}
+
+	// Move a component recorded in a command buffer into its array.
+	template<typename T>
+	static void InsertRecorded_(BasicRegistry &registry, Entity entity, void *payload)
+	{
+		registry.RegisterComponent<T>();
+		auto &array = registry.GetComponentArray<T>();
+		T &component = *static_cast<T*>(payload);
+
+		if (array.HasData(entity))
+			array.Modify(entity, registry.version_) = std::move(component);
+		else
+			array.InsertData(entity, std::move(component), registry.version_);
+
+		component.~T();
+	}
+
+	template<typename T>
+	Storage<T> &GetComponentArray()
+	{
+		return *static_cast<Storage<T>*>(component_arrays_[GetComponentType<T>()].get());
+	}
+
+	// Entity manager, indexed by EntityIndex. handles_ holds the handle of
+	// alive entities and NULL_ENTITY for free indices.
 	std::vector<Signature> signatures_;
+	std::vector<Entity> handles_;
 	std::vector<Entity> refill_entities_;
 	size_t entities_count;
+	std::atomic<Entity> next_entity_;
+	uint32_t version_;
 
 	// Component manager
-	std::unordered_map<std::type_index, std::unique_ptr<BaseComponentArray>> component_arrays_{};
+	std::array<std::unique_ptr<BaseComponentArray>, MAX_COMPONENTS> component_arrays_{};
 
 	// System manager
 	std::unordered_map<std::type_index, std::unique_ptr<System>> systems_{};
+	std::vector<System*> system_order_;
 	std::vector<EntityView*> entity_views_;
+	std::array<std::vector<EntityView*>, MAX_COMPONENTS> views_by_component_{};
+};
+
+using Registry = BasicRegistry<ComponentArray>;
+
+// Records structural changes of a registry to be applied later by
+// Registry::Playback. Recording is thread safe, so systems running in
+// parallel, or iterating a view, can create and change entities.
+template<class R>
+class BasicRegistryCommandBuffer
+{
+public:
+
+	BasicRegistryCommandBuffer(R &registry) : registry_(registry) {}
+
+	~BasicRegistryCommandBuffer()
+	{
+		// Playback consumes the commands, entities reserved by a buffer
+		// never played back would leak their index
+		for (auto &cmd : commands_)
+			if (cmd.type == CREATE_)
+				registry_.ReleaseEntity_(cmd.entity);
+		Clear_();
+	}
+
+	BasicRegistryCommandBuffer(const BasicRegistryCommandBuffer&) = delete;
+	BasicRegistryCommandBuffer &operator=(const BasicRegistryCommandBuffer&) = delete;
+
+	// Reserve a new entity, it is created on playback.
+	Entity CreateEntity()
+	{
+		Entity entity = registry_.ReserveEntity_();
+		std::lock_guard lock(mutex_);
+		commands_.push_back({entity, CREATE_});
+		return entity;
+	}
+
+	void DestroyEntity(Entity entity)
+	{
+		std::lock_guard lock(mutex_);
+		commands_.push_back({entity, DESTROY_});
+	}
+
+	// Existing components of the same types are replaced on playback.
+	template<class... Ts>
+	void AddComponents(Entity entity, Ts... components)
+	{
+		std::lock_guard lock(mutex_);
+		(RecordAdd_<Ts>(entity, std::move(components)), ...);
+	}
+
+	template<class... Ts>
+	void RemoveComponents(Entity entity)
+	{
+		Signature mask;
+		(mask.set(GetComponentTypeId<Ts>(), true), ...);
+
+		std::lock_guard lock(mutex_);
+		commands_.push_back({entity, REMOVE_, mask});
+	}
+
+	bool IsEmpty() const
+	{
+		std::lock_guard lock(mutex_);
+		return commands_.empty();
+	}
+
+private:
+
+	friend R;
+
+	static constexpr size_t BLOCK_SIZE_ = 64 * 1024;
+
+	enum CommandType_ { CREATE_, DESTROY_, ADD_, REMOVE_ };
+
+	struct Command_
+	{
+		Entity entity;
+		CommandType_ type;
+		Signature components = {};
+		void *payload = nullptr;
+		void (*insert)(R&, Entity, void*) = nullptr;
+		void (*destroy)(void*) = nullptr;
+	};
+
+	struct Block_
+	{
+		std::unique_ptr<std::byte[]> data;
+		size_t size;
+	};
+
+	template<typename T>
+	void RecordAdd_(Entity entity, T &&component)
+	{
+		static_assert(alignof(T) <= alignof(std::max_align_t));
+
+		void *payload = new (Allocate_(sizeof(T), alignof(T))) T(std::move(component));
+
+		Signature type;
+		type.set(GetComponentTypeId<T>(), true);
+
+		commands_.push_back({entity, ADD_, type, payload,
+				&R::template InsertRecorded_<T>,
+				[](void *p) { static_cast<T*>(p)->~T(); }});
+	}
+
+	// Bump allocation from reusable blocks.
+	void *Allocate_(size_t size, size_t alignment)
+	{
+		while (true)
+		{
+			if (block_index_ < blocks_.size())
+			{
+				auto &block = blocks_[block_index_];
+				size_t offset = (block_used_ + alignment - 1) & ~(alignment - 1);
+				if (offset + size <= block.size) {
+					block_used_ = offset + size;
+					return block.data.get() + offset;
+				}
+				++block_index_;
+				block_used_ = 0;
+				continue;
+			}
+
+			size_t block_size = std::max(size, BLOCK_SIZE_);
+			blocks_.push_back({std::unique_ptr<std::byte[]>(new std::byte[block_size]), block_size});
+		}
+	}
+
+	// Destroy components not moved into the registry and reset the buffer.
+	void Clear_()
+	{
+		for (auto &cmd : commands_)
+			if (cmd.payload)
+				cmd.destroy(cmd.payload);
+
+		commands_.clear();
+		block_index_ = 0;
+		block_used_ = 0;
+	}
+
+	R &registry_;
+	mutable std::mutex mutex_;
+	std::vector<Command_> commands_;
+	std::vector<Block_> blocks_;
+	size_t block_index_ = 0;
+	size_t block_used_ = 0;
 };
 
+using RegistryCommandBuffer = BasicRegistryCommandBuffer<Registry>;
+
 struct TransformComponent
 {
 	Fvec3 position;
 	Fvec3 size;
-	Fvec3 direction;
-	float spin;
+	Fquat rotation;
 };
 
 }
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "core.hpp"
+#include "ecs.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wil {
+
+class ThreadPool;
+
+// Parent of an entity, its TransformComponent is then relative to the world
+// transform of the parent. A parent without TransformComponent, destroyed or
+// NULL_ENTITY makes the entity a root.
+struct HierarchyComponent
+{
+	Entity parent = NULL_ENTITY;
+};
+
+// Cached world matrices of the entities having a TransformComponent and a
+// HierarchyComponent, and of their parents. Nodes are stored in flat arrays
+// sorted by depth, so every level is updated in one pass after its parents.
+// Only changed transforms and their descendants are recomputed.
+class TransformHierarchy
+{
+public:
+
+	TransformHierarchy(Registry &registry);
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(TransformHierarchy);
+
+	// Recompute the world matrices of changed transforms and their subtrees.
+	void Update();
+
+	// Same, levels of more than grain nodes are split in ranges run on pool.
+	void Update(ThreadPool &pool, size_t grain = 1024);
+
+	// Whether entity is a node of the hierarchy, as of the last Update.
+	bool Contains(Entity entity) const
+	{
+		uint32_t index = EntityIndex(entity);
+		return index < slots_.size() && slots_[index] != NO_SLOT && entities_[slots_[index]] == entity;
+	}
+
+	// World matrix of a node, as of the last Update.
+	const Fmat4 &GetWorld(Entity entity) const { return worlds_[slots_[EntityIndex(entity)]]; }
+
+	// Translation of the world matrix of a node.
+	Fvec3 GetWorldPosition(Entity entity) const
+	{
+		auto const& world = GetWorld(entity);
+		return Fvec3(world(0, 3), world(1, 3), world(2, 3));
+	}
+
+	// Invoke fn(Entity) on the nodes whose world matrix the last Update
+	// recomputed.
+	template<class Fn>
+	void EachUpdated(Fn &&fn) const
+	{
+		for (size_t i = 0; i < entities_.size(); ++i)
+			if (dirty_[i])
+				fn(entities_[i]);
+	}
+
+	size_t size() const { return entities_.size(); }
+
+	// Number of depth levels, a root alone is one level.
+	size_t GetLevelCount() const { return levels_.size() - 1; }
+
+	// Incremented by every Update recomputing world matrices
+	size_t revision = 0;
+
+private:
+
+	static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+	// Rebuild the nodes after structural changes, or mark changed ones dirty.
+	void Prepare_();
+
+	// Whether transforms added or removed since version change the parent
+	// of a node. Other transforms are not part of the hierarchy.
+	bool ParentsChanged_(uint32_t since);
+
+	void Rebuild_();
+
+	// Update nodes [first, last) of a single level.
+	void UpdateRange_(size_t first, size_t last);
+
+	Registry &registry_;
+
+	EntityView nodes_view_, transforms_view_;
+	size_t nodes_revision_ = 0, transforms_revision_ = 0;
+	uint32_t version_ = 0;
+
+	// Nodes sorted by depth, levels_[d] is the first node of depth d
+	std::vector<Entity> entities_;
+	std::vector<uint32_t> parents_;
+	// Nodes to update, then updated by the last Update
+	std::vector<uint8_t> dirty_;
+	std::vector<Fmat4> worlds_;
+	std::vector<size_t> levels_ = { 0 };
+
+	// Nodes without HierarchyComponent, only there as parents, and sorted
+	// parents left out for lacking a transform
+	std::vector<Entity> parent_roots_, missing_parents_;
+
+	// Node of every entity index
+	std::vector<uint32_t> slots_;
+};
+
+}
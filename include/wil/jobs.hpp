@@ -0,0 +1,64 @@
+#pragma once
+
+#include "core.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wil {
+
+// Work stealing thread pool. Every worker owns a job queue; it pops its own
+// jobs in LIFO order and steals the oldest jobs of other queues when idle.
+class ThreadPool
+{
+public:
+
+	using Job = std::function<void()>;
+
+	// By default one worker per hardware thread, minus the calling thread.
+	ThreadPool(unsigned threads = 0);
+
+	~ThreadPool();
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(ThreadPool);
+
+	// Queue a job. Jobs submitted from a worker go to its own queue.
+	void Submit(Job job);
+
+	// Run queued jobs on the calling thread until counter reaches zero.
+	void WaitFor(const std::atomic<size_t> &counter);
+
+	unsigned GetThreadCount() const { return static_cast<unsigned>(workers_.size()); }
+
+private:
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	size_t GetQueueIndex_() const;
+
+	bool TryRunJob_(size_t self);
+
+	void WorkerLoop_(size_t index);
+
+	// The last queue is shared by threads outside of the pool.
+	std::vector<std::unique_ptr<Queue>> queues_;
+	std::vector<std::thread> workers_;
+
+	std::mutex sleep_mutex_;
+	std::condition_variable sleep_cv_;
+	std::atomic<size_t> pending_;
+	bool stop_;
+};
+
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace wil {
+
+class Device;
+
+// Offsets into a range of size bytes, best fit among the free ranges which
+// are merged with their neighbours when freed.
+class FreeListAllocator
+{
+public:
+
+	static constexpr uint64_t INVALID_OFFSET = UINT64_MAX;
+
+	FreeListAllocator(uint64_t size);
+
+	// Offset of size bytes aligned to alignment, a power of two, or
+	// INVALID_OFFSET when no free range is large enough.
+	uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+
+	// Release the range returned by Allocate at offset.
+	void Free(uint64_t offset);
+
+	uint64_t GetSize() const { return size_; }
+
+	uint64_t GetUsed() const { return used_; }
+
+	size_t GetAllocationCount() const { return allocated_.size(); }
+
+	size_t GetFreeRangeCount() const { return free_by_offset_.size(); }
+
+	uint64_t GetLargestFreeRange() const { return free_by_size_.empty() ? 0 : free_by_size_.rbegin()->first; }
+
+private:
+
+	void InsertFree_(uint64_t offset, uint64_t size);
+
+	void EraseFree_(std::map<uint64_t, uint64_t>::iterator it);
+
+	uint64_t size_;
+	uint64_t used_ = 0;
+
+	std::map<uint64_t, uint64_t> free_by_offset_;
+	std::multimap<uint64_t, uint64_t> free_by_size_;
+	// Size of every allocation by offset
+	std::unordered_map<uint64_t, uint64_t> allocated_;
+};
+
+// Bytes at offset of an allocation
+struct MemoryRange
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+// Sorted, disjoint ranges written since the last Clear. Overlapping and
+// touching ranges are merged, past max_count the two closest ranges are
+// merged so a flush stays a handful of ranges.
+class DirtyRanges
+{
+public:
+
+	DirtyRanges(size_t max_count = 8) : max_count_(max_count) {}
+
+	void Add(uint64_t offset, uint64_t size);
+
+	void Clear() { ranges_.clear(); }
+
+	bool IsEmpty() const { return ranges_.empty(); }
+
+	const std::vector<MemoryRange> &GetRanges() const { return ranges_; }
+
+	// Sum of the sizes of the ranges
+	uint64_t GetBytes() const;
+
+private:
+
+	size_t max_count_;
+	std::vector<MemoryRange> ranges_;
+};
+
+// Memory bound to a buffer or image, a range of a block shared with other
+// allocations or a dedicated block for large resources.
+struct MemoryAllocation
+{
+	VendorPtr memory = nullptr;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	// Persistently mapped address of the range in host visible memory
+	void *mapped = nullptr;
+
+	uint32_t pool = 0;
+	uint32_t block = 0;
+};
+
+struct MemoryStats
+{
+	// vkAllocateMemory calls alive, blocks and dedicated allocations
+	size_t block_count = 0;
+	size_t allocation_count = 0;
+	uint64_t reserved_bytes = 0;
+	uint64_t used_bytes = 0;
+	size_t free_range_count = 0;
+	uint64_t largest_free_range = 0;
+
+	// 1 - largest free range / free bytes, 0 when the free memory is
+	// contiguous and close to 1 when it is scattered in small holes.
+	float GetFragmentation() const
+	{
+		uint64_t free = reserved_bytes - used_bytes;
+		return free ? 1.f - float(largest_free_range) / float(free) : 0.f;
+	}
+};
+
+// Carves buffers and images out of large device memory blocks, one set of
+// blocks per memory type and resource kind, so a scene of many meshes uses
+// a few vkAllocateMemory calls. Buffers and optimal tiling images never share
+// a block, which avoids bufferImageGranularity conflicts. Host visible
+// blocks are mapped once for their lifetime.
+class MemoryAllocator
+{
+public:
+
+	enum Kind
+	{
+		KIND_BUFFER,
+		KIND_IMAGE,
+	};
+
+	MemoryAllocator(Device &device, uint64_t block_size = 64ull << 20);
+
+	~MemoryAllocator();
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(MemoryAllocator);
+
+	// Memory for a resource of the given requirements and VkMemoryPropertyFlags.
+	MemoryAllocation Allocate(uint64_t size, uint64_t alignment, uint32_t type_bits, uint32_t properties, Kind kind);
+
+	// Create a buffer and bind it to new memory, returns the VkBuffer.
+	VendorPtr CreateBuffer(uint64_t size, uint32_t usage, uint32_t properties, MemoryAllocation &allocation);
+
+	// Bind a created VkImage to new memory.
+	MemoryAllocation AllocateImage(VendorPtr image, uint32_t properties);
+
+	void Free(MemoryAllocation const& allocation);
+
+	// Whether writes through allocation.mapped are visible to the device
+	// without vkFlushMappedMemoryRanges.
+	bool IsCoherent(MemoryAllocation const& allocation) const;
+
+	// Make host writes to ranges of a mapped allocation visible to the
+	// device, ranges are widened to nonCoherentAtomSize. Nothing to do on
+	// coherent memory.
+	void Flush(MemoryAllocation const& allocation, MemoryRange const *ranges, size_t count);
+
+	MemoryStats GetStats() const;
+
+private:
+
+	struct Block
+	{
+		VendorPtr memory;
+		void *mapped;
+		// Null for dedicated allocations
+		std::unique_ptr<FreeListAllocator> ranges;
+	};
+
+	struct Pool
+	{
+		uint32_t type_index;
+		Kind kind;
+		bool coherent;
+		std::vector<Block> blocks;
+	};
+
+	uint32_t FindMemoryType_(uint32_t type_bits, uint32_t properties) const;
+
+	uint32_t GetPool_(uint32_t type_index, Kind kind);
+
+	// Index of a new block of size bytes in pool, UINT32_MAX when the device
+	// is out of memory.
+	uint32_t AllocateBlock_(Pool &pool, uint64_t size, bool dedicated);
+
+	void FreeBlock_(Block &block);
+
+	Device &device_;
+	uint64_t block_size_;
+	uint64_t non_coherent_atom_size_;
+
+	// VkMemoryPropertyFlags of every memory type
+	std::vector<uint32_t> type_properties_;
+
+	std::vector<Pool> pools_;
+
+	mutable std::mutex mutex_;
+};
+
+}
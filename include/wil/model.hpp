@@ -1,6 +1,7 @@
 #pragma once
 
 #include "buffer.hpp"
+#include "bounds.hpp"
 #include <cstring>
 #include <optional>
 
@@ -12,6 +13,9 @@ struct Mesh
 	std::optional<IndexBuffer> index_buffer;
 	int material_index;
 	uint32_t draw_count;
+	// Local space bounds of the positions
+	AABB bounds;
+	BoundingSphere sphere;
 };
 
 // Currently only support .gltf/.glb files
@@ -28,9 +32,25 @@ public:
 
 	size_t GetTextureCount() const { return textures_.size(); }
 
+	// Local space bounds of all meshes
+	const AABB &GetBounds() const { return bounds_; }
+	const BoundingSphere &GetSphere() const { return sphere_; }
+
+	// Uploads of the buffers and textures, which run asynchronously
+	UploadToken GetUploadToken() const { return upload_token_; }
+
+	// Set once the uploads were acquired for graphics work, the staging
+	// ring no longer needs to be queried for the model
+	bool IsAcquired() const { return acquired_; }
+	void SetAcquired() { acquired_ = true; }
+
 private:
 	std::vector<Mesh> meshes_;
+	AABB bounds_ = {};
+	BoundingSphere sphere_ = {};
 	std::vector<Texture> textures_;
+	UploadToken upload_token_;
+	bool acquired_ = false;
 };
 
 }
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "ecs.hpp"
+#include "hierarchy.hpp"
 #include "device.hpp"
 #include "pipeline.hpp"
 #include "descriptor.hpp"
 #include "cmdbuf.hpp"
 #include "model.hpp"
+#include "bvh.hpp"
 
 namespace wil {
 
@@ -70,6 +72,10 @@ public:
 
 	Camera &GetCamera() { return camera_; }
 
+	// World bounds of the objects as of the last Render, for picking and
+	// spatial queries.
+	const AABBTree &GetObjectTree() const { return object_tree_; }
+
 private:
 
 	struct ObjectVertex
@@ -87,6 +93,8 @@ private:
 	struct ObjectPushConstant
 	{
 		WIL_ALIGN_STD140(Fmat4) model;
+		// Columns of the mat3 normal matrix, padded to vec4
+		WIL_ALIGN_STD140(Fvec4) normal[3];
 	};
 
 	struct LightPushConstant
@@ -114,6 +122,8 @@ private:
 		WIL_ALIGN_STD140(Fvec3) color;
 		WIL_ALIGN_STD140(float) linear;
 		WIL_ALIGN_STD140(float) quadratic;
+
+		bool operator==(ObjectPointLight const&) const = default;
 	};
 
 	struct ObjectSpotLight
@@ -124,6 +134,8 @@ private:
 		WIL_ALIGN_STD140(float) cutoff;
 		WIL_ALIGN_STD140(float) linear;
 		WIL_ALIGN_STD140(float) quadratic;
+
+		bool operator==(ObjectSpotLight const&) const = default;
 	};
 
 	struct ObjectStorage_0_1
@@ -147,12 +159,33 @@ private:
 
 	void CreateDescriptorSetsAndUniforms_(Device &device);
 
+	// Returns true if the lights differ from the stored table.
+	bool UpdateLights_();
+
+	// Copies the used part of lights_ into a storage of ObjectStorage_0_1.
+	void UploadLights_(StorageBuffer &storage);
+
+	// Model and normal matrices of objects_, in the order of the view.
+	void ComposeObjectModels_();
+
+	// Update the world bounds of the objects in object_tree_ and flag those
+	// intersecting the view frustum.
+	void CullObjects_(Fmat4 const& view_proj);
+
+	// Model of a component, loaded on first use.
+	Model &GetModel_(ModelComponent &mc);
+
+	// World position of an entity, following its parents if any.
+	Fvec3 GetWorldPosition_(Entity entity, TransformComponent const& tc) const;
+
 	Registry &registry_;
 	Device &device_;
 
 	EntityView objects_;
 	EntityView point_lights_, spot_lights_;
 
+	TransformHierarchy hierarchy_;
+
 	Camera camera_;
 
 	std::unique_ptr<Pipeline> object_pipeline_;
@@ -165,9 +198,21 @@ private:
 	std::vector<DescriptorSet> object_1_sets;
 	std::vector<DescriptorSet> light_0_sets;
 
-	std::vector<UniformBuffer> object_0_0_uniforms; // GlobalData
+	// Per frame constants, GlobalData of both pipelines
+	DynamicUniformBuffer frame_uniforms_;
 	std::vector<StorageBuffer> object_0_1_storages; // Lights
-	std::vector<UniformBuffer> light_0_0_uniforms; // GlobalData
+
+	std::vector<float> object_transforms_;
+	std::vector<ObjectPushConstant> object_pushes_;
+
+	Frustum frustum_;
+	AABBTree object_tree_;
+	std::vector<uint8_t> object_visible_;
+	size_t objects_revision_ = 0, hierarchy_revision_ = 0;
+	uint32_t objects_version_ = 0;
+
+	ObjectStorage_0_1 lights_{};
+	std::vector<bool> lights_uploaded_;
 
 	std::unordered_map<std::string, Model> models_;
 
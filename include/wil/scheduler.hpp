@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ecs.hpp"
+#include "jobs.hpp"
+
+namespace wil {
+
+// Runs System::Update of a list of systems on a thread pool. Two systems
+// conflict if one writes a component the other reads or writes; conflicting
+// systems run in list order, all others may run concurrently.
+class SystemScheduler
+{
+public:
+
+	SystemScheduler(ThreadPool &pool) : pool_(pool) {}
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(SystemScheduler);
+
+	// Blocks until every system has been updated.
+	void Run(const std::vector<System*> &systems, float elapsed);
+
+	static bool Conflicts(const System &a, const System &b);
+
+private:
+	ThreadPool &pool_;
+};
+
+}
@@ -0,0 +1,385 @@
+#pragma once
+
+#include "core.hpp"
+#include "ecs.hpp"
+#include "log.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace wil {
+
+// Read only content of a whole file, memory mapped where the platform
+// supports it and read into memory otherwise.
+class MappedFile
+{
+public:
+
+	MappedFile(const std::string &path);
+
+	~MappedFile();
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(MappedFile);
+
+	bool IsOpen() const { return data_ != nullptr; }
+
+	std::span<const std::byte> GetData() const { return { data_, size_ }; }
+
+private:
+
+	const std::byte *data_ = nullptr;
+	size_t size_ = 0;
+	bool mapped_ = false;
+	std::vector<std::byte> buffer_;
+};
+
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+// A snapshot is a header, the handles, signatures and free entities of the
+// registry, then one section per saved component type holding its dense
+// entity and component arrays. Sections start on 8 bytes boundaries and
+// values are stored in native byte order.
+struct SnapshotHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t slots;
+	uint32_t next_entity;
+	uint32_t refills;
+	uint32_t components;
+	uint64_t entities_count;
+};
+
+struct SnapshotComponentHeader
+{
+	uint64_t key;
+	uint32_t type;
+	uint32_t size;
+	uint64_t count;
+};
+
+// Save the entities of registry and their trivially copyable components.
+// Other components are not saved and their bits are cleared from the saved
+// signatures.
+template<template<class> class S>
+bool SaveSnapshot(BasicRegistry<S> const& registry, const std::string &path);
+
+// Replace the content of registry with a snapshot. Components are matched by
+// GetComponentTypeKey and must be registered beforehand, saved components of
+// unknown types are skipped. Component arrays are filled with one copy each
+// and views rebuilt once, without per entity inserts.
+template<template<class> class S>
+bool LoadSnapshot(BasicRegistry<S> &registry, const std::string &path);
+
+struct RegistrySnapshot_
+{
+	static constexpr size_t ALIGNMENT = 8;
+
+	static void Write_(std::ofstream &file, const void *data, size_t size)
+	{
+		static constexpr char padding[ALIGNMENT] = {};
+
+		file.write(static_cast<const char*>(data), size);
+		file.write(padding, (ALIGNMENT - size % ALIGNMENT) % ALIGNMENT);
+	}
+
+	// Bounds checked sequential reads of the snapshot content.
+	struct Reader_
+	{
+		std::span<const std::byte> data;
+		size_t offset = 0;
+
+		const std::byte *Read(size_t size)
+		{
+			if (size > data.size() - offset)
+				return nullptr;
+
+			const std::byte *result = data.data() + offset;
+			offset = std::min(data.size(), offset + (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT);
+			return result;
+		}
+
+		// Array of count elements of size bytes, counts read from the file
+		// may not fit nor multiply without wrapping
+		const std::byte *Read(uint64_t count, uint64_t size)
+		{
+			if (size && count > (data.size() - offset) / size)
+				return nullptr;
+			return Read(count * size);
+		}
+	};
+
+	template<template<class> class S>
+	static bool Save(BasicRegistry<S> const& registry, const std::string &path)
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			WIL_LOGERROR("Unable to open snapshot {}", path);
+			return false;
+		}
+
+		std::vector<std::pair<ComponentType, BaseComponentArray::SnapshotData>> components;
+		Signature saved;
+
+		for (auto const& array : registry.component_arrays_)
+		{
+			if (!array)
+				continue;
+			auto component = array->GetSnapshotData();
+			if (!component.key)
+				continue;
+			components.emplace_back(array->GetType(), component);
+			saved.set(array->GetType(), true);
+		}
+
+		SnapshotHeader header = {
+			{ 'W', 'I', 'L', 'S' },
+			SNAPSHOT_VERSION,
+			static_cast<uint32_t>(registry.signatures_.size()),
+			// Entities reserved by pending command buffers are not saved
+			static_cast<uint32_t>(std::min<size_t>(registry.next_entity_, registry.signatures_.size())),
+			static_cast<uint32_t>(registry.refill_entities_.size()),
+			static_cast<uint32_t>(components.size()),
+			registry.entities_count,
+		};
+
+		std::vector<uint64_t> signatures(registry.signatures_.size());
+		for (size_t i = 0; i < signatures.size(); ++i)
+			signatures[i] = (registry.signatures_[i] & saved).to_ullong();
+
+		Write_(file, &header, sizeof(header));
+		Write_(file, registry.handles_.data(), registry.handles_.size() * sizeof(Entity));
+		Write_(file, signatures.data(), signatures.size() * sizeof(uint64_t));
+		Write_(file, registry.refill_entities_.data(), registry.refill_entities_.size() * sizeof(Entity));
+
+		for (auto const& [type, component] : components)
+		{
+			SnapshotComponentHeader section = {
+				component.key,
+				type,
+				component.size,
+				component.entities.size(),
+			};
+
+			Write_(file, &section, sizeof(section));
+			Write_(file, component.entities.data(), component.entities.size_bytes());
+			Write_(file, component.data, component.entities.size() * component.size);
+		}
+
+		if (!file)
+		{
+			WIL_LOGERROR("Unable to write snapshot {}", path);
+			return false;
+		}
+
+		return true;
+	}
+
+	template<template<class> class S>
+	static bool Load(BasicRegistry<S> &registry, const std::string &path)
+	{
+		MappedFile file(path);
+		if (!file.IsOpen())
+		{
+			WIL_LOGERROR("Unable to open snapshot {}", path);
+			return false;
+		}
+
+		Reader_ reader = { file.GetData() };
+
+		SnapshotHeader header;
+		const std::byte *header_data = reader.Read(sizeof(header));
+		if (!header_data)
+		{
+			WIL_LOGERROR("Invalid snapshot {}", path);
+			return false;
+		}
+		std::memcpy(&header, header_data, sizeof(header));
+
+		if (std::memcmp(header.magic, "WILS", 4) || header.version != SNAPSHOT_VERSION)
+		{
+			WIL_LOGERROR("Invalid snapshot {}", path);
+			return false;
+		}
+
+		auto handles = reinterpret_cast<const Entity*>(reader.Read(header.slots, sizeof(Entity)));
+		auto signatures = reinterpret_cast<const uint64_t*>(reader.Read(header.slots, sizeof(uint64_t)));
+		auto refills = reinterpret_cast<const Entity*>(reader.Read(header.refills, sizeof(Entity)));
+
+		if ((header.slots && (!handles || !signatures)) || (header.refills && !refills))
+		{
+			WIL_LOGERROR("Truncated snapshot {}", path);
+			return false;
+		}
+
+		struct Section
+		{
+			SnapshotComponentHeader header;
+			const Entity *entities;
+			const std::byte *data;
+			// Null when the component is not registered
+			BaseComponentArray *array;
+		};
+
+		// Validate the whole file before touching the registry
+		if (header.components > file.GetData().size() / sizeof(SnapshotComponentHeader))
+		{
+			WIL_LOGERROR("Truncated snapshot {}", path);
+			return false;
+		}
+
+		// Live handles sit at their own index, free entities refill distinct
+		// unused indices, all below next_entity
+		enum : uint8_t { UNUSED, LIVE, FREE };
+		std::vector<uint8_t> slots(header.slots, UNUSED);
+		uint64_t live = 0;
+		bool consistent = header.next_entity <= header.slots;
+
+		for (uint32_t i = 0; i < header.slots && consistent; ++i)
+		{
+			if (handles[i] == NULL_ENTITY)
+				continue;
+			consistent = EntityIndex(handles[i]) == i && i < header.next_entity;
+			slots[i] = LIVE;
+			++live;
+		}
+
+		for (uint32_t i = 0; i < header.refills && consistent; ++i)
+		{
+			uint32_t index = EntityIndex(refills[i]);
+			consistent = index < header.next_entity && slots[index] == UNUSED;
+			if (consistent)
+				slots[index] = FREE;
+		}
+
+		if (!consistent || live != header.entities_count)
+		{
+			WIL_LOGERROR("Inconsistent entities in snapshot {}", path);
+			return false;
+		}
+
+		std::vector<Section> sections(header.components);
+		for (auto &section : sections)
+		{
+			const std::byte *section_data = reader.Read(sizeof(section.header));
+			if (section_data)
+			{
+				std::memcpy(&section.header, section_data, sizeof(section.header));
+				section.entities = reinterpret_cast<const Entity*>(reader.Read(section.header.count, sizeof(Entity)));
+				section.data = reader.Read(section.header.count, section.header.size);
+			}
+
+			if (!section_data || !section.entities || !section.data)
+			{
+				WIL_LOGERROR("Truncated snapshot {}", path);
+				return false;
+			}
+
+			auto it = std::find_if(registry.component_arrays_.begin(), registry.component_arrays_.end(),
+					[&section](auto const& array) { return section.header.key && array && array->GetSnapshotData().key == section.header.key; });
+			section.array = it != registry.component_arrays_.end() && section.header.type < MAX_COMPONENTS ? it->get() : nullptr;
+
+			// Registered arrays copy count components of their own size
+			if (section.array && section.header.size != section.array->GetSnapshotData().size)
+			{
+				WIL_LOGERROR("Snapshot component {:x} has size {} instead of {}", section.header.key,
+						section.header.size, section.array->GetSnapshotData().size);
+				return false;
+			}
+
+			// Every entity of a section is live and appears once, seen
+			// entities are marked until the end of the section
+			bool valid = true;
+			uint64_t i = 0;
+			for (; i < section.header.count && valid; ++i)
+			{
+				uint32_t index = EntityIndex(section.entities[i]);
+				valid = index < header.slots && slots[index] == LIVE && handles[index] == section.entities[i];
+				if (valid)
+					slots[index] = UNUSED;
+			}
+			if (!valid)
+			{
+				WIL_LOGERROR("Invalid entity in snapshot {}", path);
+				return false;
+			}
+
+			while (i)
+				slots[EntityIndex(section.entities[--i])] = LIVE;
+		}
+
+		for (auto &array : registry.component_arrays_)
+			if (array)
+				array->Clear();
+
+		// Component types are assigned at runtime and may differ from the
+		// ones the snapshot was saved with
+		std::array<int, MAX_COMPONENTS> types;
+		types.fill(-1);
+
+		for (auto const& section : sections)
+		{
+			if (!section.array)
+			{
+				WIL_LOGWARN("Snapshot component {:x} is not registered, skipped", section.header.key);
+				continue;
+			}
+
+			section.array->LoadSnapshot({ section.entities, section.header.count }, section.data, registry.version_);
+			types[section.header.type] = section.array->GetType();
+		}
+
+		registry.signatures_.resize(header.slots);
+		for (uint32_t i = 0; i < header.slots; ++i)
+		{
+			uint64_t saved;
+			std::memcpy(&saved, signatures + i, sizeof(saved));
+
+			Signature signature;
+			for (; saved; saved &= saved - 1)
+				if (int type = types[std::countr_zero(saved)]; type >= 0)
+					signature.set(type, true);
+			registry.signatures_[i] = signature;
+		}
+
+		registry.handles_.assign(handles, handles + header.slots);
+		registry.refill_entities_.assign(refills, refills + header.refills);
+		registry.next_entity_ = header.next_entity;
+		registry.entities_count = header.entities_count;
+
+		for (EntityView *view : registry.entity_views_)
+		{
+			view->Clear_();
+			if (view->pass.none())
+				continue;
+
+			for (uint32_t i = 0; i < header.slots; ++i)
+				if (handles[i] != NULL_ENTITY && (registry.signatures_[i] & view->pass) == view->pass)
+					view->Insert_(handles[i]);
+		}
+
+		return true;
+	}
+};
+
+template<template<class> class S>
+bool SaveSnapshot(BasicRegistry<S> const& registry, const std::string &path)
+{
+	return RegistrySnapshot_::Save(registry, path);
+}
+
+template<template<class> class S>
+bool LoadSnapshot(BasicRegistry<S> &registry, const std::string &path)
+{
+	return RegistrySnapshot_::Load(registry, path);
+}
+
+}
@@ -2,22 +2,110 @@
 
 #include "algebra.hpp"
 
+#include <cstddef>
+
 namespace wil {
 
+class ThreadPool;
+
 // Translation matrix (2D)
 Fmat4 TranslateModel(Fvec2 position);
 
 // Translation matrix
-Fmat4 TranslateModel(Fvec3 position);
+constexpr Fmat4 TranslateModel(Fvec3 position)
+{
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+	return {
+		Fvec4(1, 0, 0, position.x),
+		Fvec4(0, 1, 0, position.y),
+		Fvec4(0, 0, 1, position.z),
+		Fvec4(0, 0, 0, 1),
+	};
+#else
+	return {
+		Fvec4(1, 0, 0, 0),
+		Fvec4(0, 1, 0, 0),
+		Fvec4(0, 0, 1, 0),
+		position & 1
+	};
+#endif
+}
 
 // Rotation matrix (rotate about an axis)
 Fmat4 RotateModel(float rad, Fvec3 axis = Fvec3(0.0f, 0.0f, -1.0f));
 
+// Translation * rotation * scale of a normalized quaternion, built in one
+// pass without matrix products
+constexpr Fmat4 ComposeTRS(Fvec3 position, Fquat rotation, Fvec3 scale)
+{
+	auto [x, y, z, w] = rotation;
+	float xx = x * x, yy = y * y, zz = z * z;
+	float xy = x * y, xz = x * z, yz = y * z;
+	float wx = w * x, wy = w * y, wz = w * z;
+
+	// Columns of the rotation matrix scaled by the size on their axis
+	Fvec3 c0 = Fvec3(1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy)) * scale.x;
+	Fvec3 c1 = Fvec3(2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx)) * scale.y;
+	Fvec3 c2 = Fvec3(2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy)) * scale.z;
+
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+	return {
+		Fvec4(c0.x, c1.x, c2.x, position.x),
+		Fvec4(c0.y, c1.y, c2.y, position.y),
+		Fvec4(c0.z, c1.z, c2.z, position.z),
+		Fvec4(0, 0, 0, 1),
+	};
+#else
+	return {
+		c0 & 0,
+		c1 & 0,
+		c2 & 0,
+		position & 1
+	};
+#endif
+}
+
+// Translation * rotation of a normalized quaternion
+constexpr Fmat4 ComposeTR(Fvec3 position, Fquat rotation)
+{
+	return ComposeTRS(position, rotation, Fvec3(1.f));
+}
+
+// Rotation matrix of a normalized quaternion
+constexpr Fmat4 RotateModel(Fquat rotation)
+{
+	return ComposeTRS(Fvec3(0.f), rotation, Fvec3(1.f));
+}
+
+// mat = TranslateModel(position) * mat, mat must be affine.
+constexpr void PreTranslate(Fmat4 &mat, Fvec3 position)
+{
+	mat(0, 3) += position.x;
+	mat(1, 3) += position.y;
+	mat(2, 3) += position.z;
+}
+
+// mat = mat * ScaleModel(scale), scaling the first three columns.
+constexpr void PostScale(Fmat4 &mat, Fvec3 scale)
+{
+	for (unsigned r = 0; r < 4; ++r)
+		for (unsigned c = 0; c < 3; ++c)
+			mat(r, c) *= scale[c];
+}
+
 // Scale matrix (2D)
 Fmat4 ScaleModel(Fvec2 scale);
 
 // Scale matrix
-Fmat4 ScaleModel(Fvec3 scale);
+constexpr Fmat4 ScaleModel(Fvec3 scale)
+{
+	return {
+		Fvec4(scale.x, 0, 0, 0),
+		Fvec4(0, scale.y, 0, 0),
+		Fvec4(0, 0, scale.z, 0),
+		Fvec4(0, 0, 0, 1)
+	};
+}
 
 // 3 dimensional view matrix, look at a certain position
 Fmat4 LookAtView(Fvec3 position, Fvec3 orientation, Fvec3 up = Fvec3(0.0f, 1.0f, 0.0f));
@@ -28,5 +116,23 @@ Fmat4 OrthogonalProjection(float left, float right, float bottom, float top, flo
 // Perspective projection matrix
 Fmat4 PerspectiveProjection(float fovy, float aspect, float near, float far);
 
-}
+// Transforms of many objects in structure of arrays layout, every array
+// holds count floats. Rotations are unit quaternions (x, y, z, w), leaving
+// their arrays null means no rotation.
+struct TransformBatch
+{
+	size_t count;
+	const float *px, *py, *pz;
+	const float *sx, *sy, *sz;
+	const float *qx = nullptr, *qy = nullptr, *qz = nullptr, *qw = nullptr;
+};
+
+// Write the model matrices T * R * S of a batch, 4 objects at a time. Matrix
+// i is written at dst + i * stride bytes, so dst may point to the first
+// matrix of an array of structures, e.g. in a mapped buffer.
+void ComposeModels(TransformBatch const& batch, void *dst, size_t stride = sizeof(Fmat4));
 
+// Same, split in ranges of grain objects run on pool.
+void ComposeModels(TransformBatch const& batch, void *dst, size_t stride, ThreadPool &pool, size_t grain = 4096);
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "device.hpp"
+#include "memory.hpp"
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace wil {
+
+// Copies of an upload batch submission. Serials grow with every submission,
+// a token covers the submissions of lower serials too.
+struct UploadToken
+{
+	uint64_t serial = 0;
+};
+
+// Persistently mapped host buffer that uploads are staged in. Space is
+// handed out in order and given back once the transfer which copied out of
+// it finished, so uploads never wait on a queue unless the ring is full.
+// Copies run on the transfer queue of the device and signal a timeline
+// semaphore. Not thread safe, batches are recorded on the thread owning the
+// device.
+class StagingRing
+{
+public:
+
+	StagingRing(Device &device, uint64_t size = 32ull << 20);
+
+	~StagingRing();
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(StagingRing);
+
+	uint64_t GetSize() const { return size_; }
+
+	// Bytes held by open and in flight batches
+	uint64_t GetUsed() const { return head_ - tail_; }
+
+	size_t GetInFlightCount() const { return in_flight_.size(); }
+
+	// Whether the copies of the token landed as of the last Retire, a
+	// lookup without any device call
+	bool IsComplete(UploadToken token) const;
+
+	// Makes the resources of the token usable by graphics queue work
+	// submitted afterwards. With a dedicated transfer queue this submits
+	// the queue family ownership acquire, which waits on the GPU for the
+	// copies instead of the host.
+	void Acquire(UploadToken token);
+
+	// Blocks until the copies of the token landed
+	void Wait(UploadToken token);
+
+	// Gives back the space of finished batches without blocking, once per
+	// frame is enough to observe completions
+	void Retire();
+
+	// Blocks until every submitted batch finished
+	void WaitIdle();
+
+private:
+
+	friend class UploadBatch;
+
+	struct Staging
+	{
+		VendorPtr buffer = nullptr;
+		uint64_t offset = 0;
+		void *mapped = nullptr;
+	};
+
+	// Staging buffer of an upload larger than the free space of the ring
+	struct Temporary
+	{
+		VendorPtr buffer;
+		MemoryAllocation allocation;
+	};
+
+	// Resource released by the transfer queue, to be acquired by the
+	// graphics queue
+	struct Ownership
+	{
+		VendorPtr resource;
+		uint64_t offset, size;
+		bool image;
+	};
+
+	struct Submission
+	{
+		// Value of the timeline semaphore signaled by the copies
+		uint64_t value;
+		VendorPtr cb;
+		std::vector<Temporary> temporaries;
+	};
+
+	struct Release
+	{
+		uint64_t value;
+		std::vector<Ownership> resources;
+	};
+
+	struct Acquisition
+	{
+		VendorPtr fence, cb;
+	};
+
+	struct Range
+	{
+		uint64_t end, serial;
+	};
+
+	uint64_t Open_();
+	Staging Reserve_(uint64_t serial, uint64_t size, uint64_t alignment);
+	VendorPtr BeginCommandBuffer_(VendorPtr pool, std::vector<VendorPtr> &free_cbs);
+	void Submit_(uint64_t serial, VendorPtr cb, std::vector<Temporary> temporaries, std::vector<Ownership> released);
+	void WaitValue_(uint64_t value);
+	void Recycle_(Submission &submission);
+
+	Device &device_;
+	uint64_t size_;
+	VendorPtr buffer_ptr_;
+	MemoryAllocation allocation_;
+
+	// Copies change queue family when the transfer queue is dedicated
+	bool transfer_ownership_;
+	VendorPtr transfer_pool_ptr_, graphics_pool_ptr_;
+	VendorPtr timeline_ptr_;
+	uint64_t timeline_value_ = 0;
+
+	// Ring positions grow forever, offsets are taken modulo the size
+	uint64_t head_ = 0, tail_ = 0;
+	std::deque<Range> ranges_;
+
+	uint64_t next_serial_ = 1;
+	std::set<uint64_t> open_;
+	std::map<uint64_t, Submission> in_flight_;
+	std::map<uint64_t, Release> released_;
+	std::vector<Acquisition> acquiring_;
+	std::vector<VendorPtr> free_fences_, free_transfer_cbs_, free_graphics_cbs_;
+};
+
+// Copies recorded into a single command buffer, staged in the ring of the
+// device and submitted to its transfer queue. Loading a model through one
+// batch costs one submission instead of a queue wait per resource.
+// Destination resources must not be in use by the GPU and must stay alive
+// until the batch finished, pending copies are submitted on destruction.
+class UploadBatch
+{
+public:
+
+	UploadBatch(Device &device);
+
+	~UploadBatch();
+
+	WIL_DELETE_COPY_AND_REASSIGNMENT(UploadBatch);
+
+	void CopyToBuffer(VendorPtr buffer, uint64_t offset, const void *src, uint64_t size);
+
+	// Whole image copy of tightly packed texels, leaves the image in the
+	// shader read only layout
+	void CopyToImage(VendorPtr image, uint32_t width, uint32_t height, const void *src, uint64_t size);
+
+	// Records nothing if the batch is empty, the batch can be reused after.
+	// The token covers every copy submitted through the batch so far.
+	UploadToken Submit();
+
+	// Blocks until every copy submitted through the batch landed
+	void Wait();
+
+	bool IsEmpty() const { return !cb_ptr_; }
+
+private:
+
+	StagingRing::Staging Stage_(const void *src, uint64_t size, uint64_t alignment);
+
+	Device &device_;
+	StagingRing &ring_;
+
+	uint64_t serial_ = 0;
+	bool staged_ = false;
+	VendorPtr cb_ptr_ = nullptr;
+	std::vector<StagingRing::Temporary> temporaries_;
+	std::vector<StagingRing::Ownership> released_;
+	UploadToken token_;
+};
+
+}
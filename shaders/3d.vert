@@ -16,7 +16,7 @@ layout(set = 0, binding = 0) uniform GlobalData {
 
 layout(push_constant) uniform PushConstant {
     mat4 model;
-	bool has_texture;
+	mat3 normal;
 } push;
 
 void main()
@@ -24,6 +24,6 @@ void main()
 	gl_Position = uGlobal.proj * uGlobal.view * push.model * vec4(iPos, 1.f);
 	vTexCoord = iTexCoord;
 	vFragPos = vec3(push.model * vec4(iPos, 1.f));
-	vNormal = mat3(transpose(inverse(push.model))) * iNormal;
+	vNormal = push.normal * iNormal;
 }
 
@@ -0,0 +1,369 @@
+#include <wil/batch.hpp>
+#include <wil/log.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+namespace wil {
+
+static_assert(sizeof(Fvec3) == 3 * sizeof(float) && sizeof(Fvec4) == 4 * sizeof(float));
+
+#ifdef WIL_SIMD_SSE
+
+// Run fn(std::true_type) if every pointer is 16 bytes aligned, otherwise
+// fn(std::false_type). Returns the number of elements fn processed.
+template<class Fn, class... Ps>
+static size_t DispatchAligned_(Fn &&fn, const Ps*... ptrs)
+{
+	if (((reinterpret_cast<uintptr_t>(ptrs) % 16 == 0) && ...))
+		return fn(std::true_type{});
+	return fn(std::false_type{});
+}
+
+template<bool ALIGNED>
+static __m128 LoadBatch_(const float *src)
+{
+	if constexpr (ALIGNED)
+		return _mm_load_ps(src);
+	else
+		return _mm_loadu_ps(src);
+}
+
+template<bool ALIGNED>
+static void StoreBatch_(float *dst, __m128 value)
+{
+	if constexpr (ALIGNED)
+		_mm_store_ps(dst, value);
+	else
+		_mm_storeu_ps(dst, value);
+}
+
+// Load 4 Fvec3 as x, y and z registers
+template<bool ALIGNED>
+static void Load3_(const Fvec3 *src, __m128 &x, __m128 &y, __m128 &z)
+{
+	const float *f = &src->x;
+	__m128 a0 = LoadBatch_<ALIGNED>(f);     // x0 y0 z0 x1
+	__m128 a1 = LoadBatch_<ALIGNED>(f + 4); // y1 z1 x2 y2
+	__m128 a2 = LoadBatch_<ALIGNED>(f + 8); // z2 x3 y3 z3
+
+	__m128 t = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(1, 1, 2, 2));
+	x = _mm_shuffle_ps(a0, t, _MM_SHUFFLE(2, 0, 3, 0));
+
+	__m128 lo = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(0, 0, 1, 1));
+	__m128 hi = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(2, 2, 3, 3));
+	y = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+
+	lo = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 1, 2, 2));
+	hi = _mm_shuffle_ps(a2, a2, _MM_SHUFFLE(3, 3, 0, 0));
+	z = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+// Store x, y and z registers as 4 Fvec3
+template<bool ALIGNED>
+static void Store3_(Fvec3 *dst, __m128 x, __m128 y, __m128 z)
+{
+	float *f = &dst->x;
+
+	__m128 lo = _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 hi = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0));
+	StoreBatch_<ALIGNED>(f, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+
+	lo = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1));
+	hi = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2));
+	StoreBatch_<ALIGNED>(f + 4, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+
+	lo = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2));
+	hi = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3));
+	StoreBatch_<ALIGNED>(f + 8, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+// 1 / sqrt(value)
+static __m128 InvSqrt_(__m128 value, BatchPrecision precision)
+{
+	if (precision == BATCH_FAST)
+	{
+		// One Newton step: y * (1.5 - 0.5 * value * y * y)
+		__m128 y = _mm_rsqrt_ps(value);
+		__m128 half = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), value), y);
+		return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(half, y)));
+	}
+
+	return _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(value));
+}
+
+// First 3 rows of mat times (x, y, z, w) for 4 vectors
+static size_t Transform3_(Fmat4 const& mat, const Fvec3 *src, Fvec3 *dst, size_t count, float w)
+{
+	__m128 m[3][4];
+	for (unsigned r = 0; r < 3; ++r)
+		for (unsigned c = 0; c < 4; ++c)
+			m[r][c] = _mm_set1_ps(c < 3 ? mat(r, c) : mat(r, c) * w);
+
+	return DispatchAligned_([&](auto aligned) {
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x, y, z, res[3];
+			Load3_<aligned>(src + i, x, y, z);
+			for (unsigned r = 0; r < 3; ++r)
+				res[r] = MulAdd_(m[r][0], x, MulAdd_(m[r][1], y, MulAdd_(m[r][2], z, m[r][3])));
+			Store3_<aligned>(dst + i, res[0], res[1], res[2]);
+		}
+		return i;
+	}, src, dst);
+}
+
+#endif
+
+void TransformPoints(Fmat4 const& mat, std::span<const Fvec3> src, std::span<Fvec3> dst)
+{
+	WIL_ASSERT(dst.size() >= src.size());
+	size_t i = 0;
+
+#ifdef WIL_SIMD_SSE
+	i = Transform3_(mat, src.data(), dst.data(), src.size(), 1.f);
+#endif
+
+	for (; i < src.size(); ++i)
+	{
+		Fvec4 res = mat * (src[i] & 1.f);
+		dst[i] = Fvec3(res.x, res.y, res.z);
+	}
+}
+
+void TransformDirections(Fmat4 const& mat, std::span<const Fvec3> src, std::span<Fvec3> dst)
+{
+	WIL_ASSERT(dst.size() >= src.size());
+	size_t i = 0;
+
+#ifdef WIL_SIMD_SSE
+	i = Transform3_(mat, src.data(), dst.data(), src.size(), 0.f);
+#endif
+
+	for (; i < src.size(); ++i)
+	{
+		Fvec4 res = mat * (src[i] & 0.f);
+		dst[i] = Fvec3(res.x, res.y, res.z);
+	}
+}
+
+void TransformVectors(Fmat4 const& mat, std::span<const Fvec4> src, std::span<Fvec4> dst)
+{
+	WIL_ASSERT(dst.size() >= src.size());
+	size_t i = 0;
+
+#ifdef WIL_SIMD_SSE
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+	Fmat4 const cols = Transpose(mat);
+#else
+	Fmat4 const& cols = mat;
+#endif
+
+	i = DispatchAligned_([&](auto aligned) {
+		size_t j = 0;
+		for (; j < src.size(); ++j)
+			StoreBatch_<aligned>(&dst[j].x, Combine_(cols, LoadBatch_<aligned>(&src[j].x)));
+		return j;
+	}, src.data(), dst.data());
+#endif
+
+	for (; i < src.size(); ++i)
+		dst[i] = mat * src[i];
+}
+
+void NormalizeBatch(std::span<const Fvec3> src, std::span<Fvec3> dst, BatchPrecision precision)
+{
+	WIL_ASSERT(dst.size() >= src.size());
+	size_t i = 0;
+
+#ifdef WIL_SIMD_SSE
+	i = DispatchAligned_([&](auto aligned) {
+		size_t j = 0;
+		for (; j + 4 <= src.size(); j += 4)
+		{
+			__m128 x, y, z;
+			Load3_<aligned>(&src[j], x, y, z);
+			__m128 inv = InvSqrt_(MulAdd_(x, x, MulAdd_(y, y, _mm_mul_ps(z, z))), precision);
+			Store3_<aligned>(&dst[j], _mm_mul_ps(x, inv), _mm_mul_ps(y, inv), _mm_mul_ps(z, inv));
+		}
+		return j;
+	}, src.data(), dst.data());
+#endif
+
+	for (; i < src.size(); ++i)
+		dst[i] = Normalize(src[i]);
+}
+
+void NormalizeBatch(std::span<const Fvec4> src, std::span<Fvec4> dst, BatchPrecision precision)
+{
+	WIL_ASSERT(dst.size() >= src.size());
+	size_t i = 0;
+
+#ifdef WIL_SIMD_SSE
+	i = DispatchAligned_([&](auto aligned) {
+		size_t j = 0;
+		for (; j + 4 <= src.size(); j += 4)
+		{
+			__m128 v[4], t[4];
+			for (unsigned k = 0; k < 4; ++k)
+				v[k] = t[k] = LoadBatch_<aligned>(&src[j + k].x);
+
+			// Lanes of t[k] are the k-th components of the 4 vectors
+			_MM_TRANSPOSE4_PS(t[0], t[1], t[2], t[3]);
+			__m128 inv = InvSqrt_(MulAdd_(t[0], t[0], MulAdd_(t[1], t[1],
+					MulAdd_(t[2], t[2], _mm_mul_ps(t[3], t[3])))), precision);
+
+			StoreBatch_<aligned>(&dst[j].x, _mm_mul_ps(v[0], _mm_shuffle_ps(inv, inv, _MM_SHUFFLE(0, 0, 0, 0))));
+			StoreBatch_<aligned>(&dst[j + 1].x, _mm_mul_ps(v[1], _mm_shuffle_ps(inv, inv, _MM_SHUFFLE(1, 1, 1, 1))));
+			StoreBatch_<aligned>(&dst[j + 2].x, _mm_mul_ps(v[2], _mm_shuffle_ps(inv, inv, _MM_SHUFFLE(2, 2, 2, 2))));
+			StoreBatch_<aligned>(&dst[j + 3].x, _mm_mul_ps(v[3], _mm_shuffle_ps(inv, inv, _MM_SHUFFLE(3, 3, 3, 3))));
+		}
+		return j;
+	}, src.data(), dst.data());
+#endif
+
+	for (; i < src.size(); ++i)
+		dst[i] = Normalize(src[i]);
+}
+
+void DotBatch(std::span<const Fvec3> a, std::span<const Fvec3> b, std::span<float> dst)
+{
+	WIL_ASSERT(b.size() >= a.size() && dst.size() >= a.size());
+	size_t i = 0;
+
+#ifdef WIL_SIMD_SSE
+	i = DispatchAligned_([&](auto aligned) {
+		size_t j = 0;
+		for (; j + 4 <= a.size(); j += 4)
+		{
+			__m128 ax, ay, az, bx, by, bz;
+			Load3_<aligned>(&a[j], ax, ay, az);
+			Load3_<aligned>(&b[j], bx, by, bz);
+			StoreBatch_<aligned>(&dst[j], MulAdd_(ax, bx, MulAdd_(ay, by, _mm_mul_ps(az, bz))));
+		}
+		return j;
+	}, a.data(), b.data(), dst.data());
+#endif
+
+	for (; i < a.size(); ++i)
+		dst[i] = Dot(a[i], b[i]);
+}
+
+void DotBatch(std::span<const Fvec4> a, std::span<const Fvec4> b, std::span<float> dst)
+{
+	WIL_ASSERT(b.size() >= a.size() && dst.size() >= a.size());
+	size_t i = 0;
+
+#ifdef WIL_SIMD_SSE
+	i = DispatchAligned_([&](auto aligned) {
+		size_t j = 0;
+		for (; j + 4 <= a.size(); j += 4)
+		{
+			__m128 p[4];
+			for (unsigned k = 0; k < 4; ++k)
+				p[k] = _mm_mul_ps(LoadBatch_<aligned>(&a[j + k].x), LoadBatch_<aligned>(&b[j + k].x));
+
+			// Sum the lanes of every product
+			_MM_TRANSPOSE4_PS(p[0], p[1], p[2], p[3]);
+			StoreBatch_<aligned>(&dst[j], _mm_add_ps(_mm_add_ps(p[0], p[1]), _mm_add_ps(p[2], p[3])));
+		}
+		return j;
+	}, a.data(), b.data(), dst.data());
+#endif
+
+	for (; i < a.size(); ++i)
+		dst[i] = Dot(a[i], b[i]);
+}
+
+
+void MinMaxBatch(std::span<const Fvec3> points, Fvec3 &min, Fvec3 &max)
+{
+	size_t i = 0;
+
+#ifdef WIL_SIMD_SSE
+	// 4 points are 3 registers holding x y z x, y z x y and z x y z, every
+	// lane keeps the extremes of a single component until the end
+	__m128 lo[3], hi[3];
+	lo[0] = _mm_setr_ps(min.x, min.y, min.z, min.x);
+	lo[1] = _mm_setr_ps(min.y, min.z, min.x, min.y);
+	lo[2] = _mm_setr_ps(min.z, min.x, min.y, min.z);
+	hi[0] = _mm_setr_ps(max.x, max.y, max.z, max.x);
+	hi[1] = _mm_setr_ps(max.y, max.z, max.x, max.y);
+	hi[2] = _mm_setr_ps(max.z, max.x, max.y, max.z);
+
+	i = DispatchAligned_([&](auto aligned) {
+		size_t j = 0;
+		for (; j + 4 <= points.size(); j += 4)
+		{
+			for (unsigned k = 0; k < 3; ++k)
+			{
+				__m128 a = LoadBatch_<aligned>(&points[j].x + 4 * k);
+				lo[k] = _mm_min_ps(lo[k], a);
+				hi[k] = _mm_max_ps(hi[k], a);
+			}
+		}
+		return j;
+	}, points.data());
+
+	float l[12], h[12];
+	for (unsigned k = 0; k < 3; ++k)
+	{
+		_mm_storeu_ps(l + 4 * k, lo[k]);
+		_mm_storeu_ps(h + 4 * k, hi[k]);
+	}
+
+	for (unsigned c = 0; c < 3; ++c)
+	{
+		// Lanes c, c + 3, c + 6 and c + 9 hold component c
+		min[c] = std::min(std::min(l[c], l[c + 3]), std::min(l[c + 6], l[c + 9]));
+		max[c] = std::max(std::max(h[c], h[c + 3]), std::max(h[c + 6], h[c + 9]));
+	}
+#endif
+
+	for (; i < points.size(); ++i)
+	{
+		for (unsigned c = 0; c < 3; ++c)
+		{
+			min[c] = std::min(min[c], points[i][c]);
+			max[c] = std::max(max[c], points[i][c]);
+		}
+	}
+}
+
+float MaxDistanceSquaredBatch(std::span<const Fvec3> points, Fvec3 center)
+{
+	size_t i = 0;
+	float res = 0.f;
+
+#ifdef WIL_SIMD_SSE
+	__m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	__m128 best = _mm_setzero_ps();
+
+	i = DispatchAligned_([&](auto aligned) {
+		size_t j = 0;
+		for (; j + 4 <= points.size(); j += 4)
+		{
+			__m128 x, y, z;
+			Load3_<aligned>(&points[j], x, y, z);
+			x = _mm_sub_ps(x, cx), y = _mm_sub_ps(y, cy), z = _mm_sub_ps(z, cz);
+			best = _mm_max_ps(best, MulAdd_(x, x, MulAdd_(y, y, _mm_mul_ps(z, z))));
+		}
+		return j;
+	}, points.data());
+
+	best = _mm_max_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(2, 3, 0, 1)));
+	best = _mm_max_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(1, 0, 3, 2)));
+	res = _mm_cvtss_f32(best);
+#endif
+
+	for (; i < points.size(); ++i)
+	{
+		Fvec3 d = points[i] - center;
+		res = std::max(res, Dot(d, d));
+	}
+	return res;
+}
+
+}
@@ -0,0 +1,260 @@
+#include <wil/bounds.hpp>
+#include <wil/batch.hpp>
+#include <wil/log.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+namespace wil {
+
+AABB ComputeAABB(std::span<const Fvec3> points)
+{
+	AABB box = { Fvec3(std::numeric_limits<float>::max()), Fvec3(std::numeric_limits<float>::lowest()) };
+	MinMaxBatch(points, box.min, box.max);
+	return box;
+}
+
+BoundingSphere ComputeBoundingSphere(std::span<const Fvec3> points, AABB const& box)
+{
+	Fvec3 center = (box.min + box.max) * 0.5f;
+	return { center, std::sqrt(MaxDistanceSquaredBatch(points, center)) };
+}
+
+BoundingSphere Merge(BoundingSphere const& a, BoundingSphere const& b, Fvec3 center)
+{
+	float radius = std::max((a.center - center).Norm() + a.radius, (b.center - center).Norm() + b.radius);
+	return { center, radius };
+}
+
+AABB Merge(AABB const& a, AABB const& b)
+{
+	return {
+		Fvec3(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z)),
+		Fvec3(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z)),
+	};
+}
+
+AABB TransformAABB(AABB const& box, Fmat4 const& mat)
+{
+	Fvec3 center = (box.min + box.max) * 0.5f;
+	Fvec3 extent = (box.max - box.min) * 0.5f;
+
+	// Extent of the transformed box is the absolute matrix times the extent
+	Fvec3 new_center, new_extent;
+	for (unsigned r = 0; r < 3; ++r)
+	{
+		new_center[r] = mat(r, 0) * center.x + mat(r, 1) * center.y + mat(r, 2) * center.z + mat(r, 3);
+		new_extent[r] = std::abs(mat(r, 0)) * extent.x + std::abs(mat(r, 1)) * extent.y + std::abs(mat(r, 2)) * extent.z;
+	}
+
+	return { new_center - new_extent, new_center + new_extent };
+}
+
+BoundingSphere TransformSphere(BoundingSphere const& sphere, Fmat4 const& mat)
+{
+	Fvec3 center;
+	float scale = 0.f;
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		center[i] = mat(i, 0) * sphere.center.x + mat(i, 1) * sphere.center.y + mat(i, 2) * sphere.center.z + mat(i, 3);
+		Fvec3 axis = { mat(0, i), mat(1, i), mat(2, i) };
+		scale = std::max(scale, Dot(axis, axis));
+	}
+
+	return { center, sphere.radius * std::sqrt(scale) };
+}
+
+bool IntersectRay(AABB const& box, Fvec3 origin, Fvec3 inv_direction, float max_t, float &t)
+{
+	// Slabs test, NaN from a zero direction on a slab boundary is ignored
+	// by the order of min and max
+	float t_min = 0.f, t_max = max_t;
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		float t1 = (box.min[i] - origin[i]) * inv_direction[i];
+		float t2 = (box.max[i] - origin[i]) * inv_direction[i];
+		t_min = std::max(t_min, std::min(t1, t2));
+		t_max = std::min(t_max, std::max(t1, t2));
+	}
+
+	t = t_min;
+	return t_min <= t_max;
+}
+
+Frustum Frustum::FromMatrix(Fmat4 const& mat)
+{
+	Fvec4 rows[4];
+	for (unsigned i = 0; i < 4; ++i)
+		rows[i] = Fvec4(mat(i, 0), mat(i, 1), mat(i, 2), mat(i, 3));
+
+	// Clip space volume is -w <= x, y, z <= w
+	Frustum frustum = { {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2],
+	} };
+
+	for (auto &plane : frustum.planes)
+		plane = plane / Fvec3(plane.x, plane.y, plane.z).Norm();
+	return frustum;
+}
+
+bool Frustum::Intersects(AABB const& box) const
+{
+	Fvec3 center = (box.min + box.max) * 0.5f;
+	Fvec3 extent = (box.max - box.min) * 0.5f;
+
+	// Outside when the corner furthest along the normal is behind a plane
+	for (auto const& p : planes)
+	{
+		float dist = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+		float radius = std::abs(p.x) * extent.x + std::abs(p.y) * extent.y + std::abs(p.z) * extent.z;
+		if (dist + radius < 0)
+			return false;
+	}
+
+	return true;
+}
+
+Containment Frustum::Classify(AABB const& box) const
+{
+	Fvec3 center = (box.min + box.max) * 0.5f;
+	Fvec3 extent = (box.max - box.min) * 0.5f;
+
+	// Inside when the nearest corner is in front of every plane
+	Containment result = CONTAINMENT_INSIDE;
+	for (auto const& p : planes)
+	{
+		float dist = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+		float radius = std::abs(p.x) * extent.x + std::abs(p.y) * extent.y + std::abs(p.z) * extent.z;
+		if (dist + radius < 0)
+			return CONTAINMENT_OUTSIDE;
+		if (dist - radius < 0)
+			result = CONTAINMENT_PARTIAL;
+	}
+
+	return result;
+}
+
+bool Frustum::Intersects(BoundingSphere const& sphere) const
+{
+	for (auto const& p : planes)
+		if (p.x * sphere.center.x + p.y * sphere.center.y + p.z * sphere.center.z + p.w + sphere.radius < 0)
+			return false;
+
+	return true;
+}
+
+#ifdef WIL_SIMD_SSE
+
+// Plane components broadcast to every lane
+struct FrustumLanes_
+{
+	__m128 x[6], y[6], z[6], w[6];
+	__m128 abs_x[6], abs_y[6], abs_z[6];
+
+	FrustumLanes_(Frustum const& frustum)
+	{
+		for (unsigned i = 0; i < 6; ++i)
+		{
+			auto const& p = frustum.planes[i];
+			x[i] = _mm_set1_ps(p.x), y[i] = _mm_set1_ps(p.y);
+			z[i] = _mm_set1_ps(p.z), w[i] = _mm_set1_ps(p.w);
+			abs_x[i] = _mm_set1_ps(std::abs(p.x));
+			abs_y[i] = _mm_set1_ps(std::abs(p.y));
+			abs_z[i] = _mm_set1_ps(std::abs(p.z));
+		}
+	}
+
+	// Mask of the lanes whose volume is not behind any plane
+	int Test(__m128 cx, __m128 cy, __m128 cz, __m128 ex, __m128 ey, __m128 ez) const
+	{
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (unsigned i = 0; i < 6; ++i)
+		{
+			__m128 dist = MulAdd_(x[i], cx, MulAdd_(y[i], cy, MulAdd_(z[i], cz, w[i])));
+			dist = MulAdd_(abs_x[i], ex, MulAdd_(abs_y[i], ey, MulAdd_(abs_z[i], ez, dist)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+		}
+		return _mm_movemask_ps(inside);
+	}
+};
+
+#endif
+
+size_t CullAABBs(Frustum const& frustum, std::span<const AABB> boxes, std::span<uint8_t> visible)
+{
+	WIL_ASSERT(visible.size() >= boxes.size());
+	size_t i = 0, count = 0;
+
+#ifdef WIL_SIMD_SSE
+	FrustumLanes_ lanes(frustum);
+	__m128 half = _mm_set1_ps(0.5f);
+
+	for (; i + 4 <= boxes.size(); i += 4)
+	{
+		const AABB *b = &boxes[i];
+		__m128 min_x = _mm_setr_ps(b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x);
+		__m128 min_y = _mm_setr_ps(b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y);
+		__m128 min_z = _mm_setr_ps(b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z);
+		__m128 max_x = _mm_setr_ps(b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x);
+		__m128 max_y = _mm_setr_ps(b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y);
+		__m128 max_z = _mm_setr_ps(b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z);
+
+		int mask = lanes.Test(
+			_mm_mul_ps(_mm_add_ps(min_x, max_x), half),
+			_mm_mul_ps(_mm_add_ps(min_y, max_y), half),
+			_mm_mul_ps(_mm_add_ps(min_z, max_z), half),
+			_mm_mul_ps(_mm_sub_ps(max_x, min_x), half),
+			_mm_mul_ps(_mm_sub_ps(max_y, min_y), half),
+			_mm_mul_ps(_mm_sub_ps(max_z, min_z), half));
+
+		for (unsigned k = 0; k < 4; ++k)
+			visible[i + k] = (mask >> k) & 1;
+		count += std::popcount(static_cast<unsigned>(mask));
+	}
+#endif
+
+	for (; i < boxes.size(); ++i)
+		count += visible[i] = frustum.Intersects(boxes[i]);
+	return count;
+}
+
+size_t CullSpheres(Frustum const& frustum, std::span<const BoundingSphere> spheres, std::span<uint8_t> visible)
+{
+	WIL_ASSERT(visible.size() >= spheres.size());
+	size_t i = 0, count = 0;
+
+#ifdef WIL_SIMD_SSE
+	FrustumLanes_ lanes(frustum);
+
+	for (; i + 4 <= spheres.size(); i += 4)
+	{
+		const BoundingSphere *s = &spheres[i];
+		__m128 radius = _mm_setr_ps(s[0].radius, s[1].radius, s[2].radius, s[3].radius);
+
+		// Signed distance of the centers to every plane against the radius
+		int mask = 15;
+		__m128 cx = _mm_setr_ps(s[0].center.x, s[1].center.x, s[2].center.x, s[3].center.x);
+		__m128 cy = _mm_setr_ps(s[0].center.y, s[1].center.y, s[2].center.y, s[3].center.y);
+		__m128 cz = _mm_setr_ps(s[0].center.z, s[1].center.z, s[2].center.z, s[3].center.z);
+		for (unsigned p = 0; p < 6; ++p)
+		{
+			__m128 dist = MulAdd_(lanes.x[p], cx, MulAdd_(lanes.y[p], cy, MulAdd_(lanes.z[p], cz, lanes.w[p])));
+			mask &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+		}
+
+		for (unsigned k = 0; k < 4; ++k)
+			visible[i + k] = (mask >> k) & 1;
+		count += std::popcount(static_cast<unsigned>(mask));
+	}
+#endif
+
+	for (; i < spheres.size(); ++i)
+		count += visible[i] = frustum.Intersects(spheres[i]);
+	return count;
+}
+
+}
@@ -1,6 +1,7 @@
 #include <wil/buffer.hpp>
 #include <wil/log.hpp>
 
+#include <algorithm>
 #include <cstring>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -8,146 +9,34 @@
 
 namespace wil {
 
-static uint32_t FindMemoryTypeIndex_(VkPhysicalDevice device, uint32_t filter, VkMemoryPropertyFlags flags)
+static VkBuffer
+CreateBuffer_(Device &device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, MemoryAllocation &allocation)
 {
-    VkPhysicalDeviceMemoryProperties mp;
-    vkGetPhysicalDeviceMemoryProperties(device, &mp);
-
-    for (uint32_t i = 0; i < mp.memoryTypeCount; i++)
-    {
-        if (filter & (1 << i) && (mp.memoryTypes[i].propertyFlags & flags) == flags) {
-            return i;
-        }
-    }
-
-	return -1;
-
+	return static_cast<VkBuffer>(device.GetAllocator().CreateBuffer(size, usage, props, allocation));
 }
 
-static std::pair<VkBuffer, VkDeviceMemory>
-CreateBufferAndAllocateMemory_(VkDevice device, VkPhysicalDevice pd, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props)
+static void DestroyBuffer_(Device &device, VendorPtr buffer, MemoryAllocation const& allocation)
 {
-    std::pair<VkBuffer, VkDeviceMemory> result;
-
-    VkBufferCreateInfo buffer_ci{};
-    buffer_ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buffer_ci.size = size;
-    buffer_ci.usage = usage;
-    buffer_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(device, &buffer_ci, nullptr, &result.first) != VK_SUCCESS)
-		WIL_LOGERROR("Unable to create buffer");
-
-    VkMemoryRequirements req;
-    vkGetBufferMemoryRequirements(device, result.first, &req);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = req.size;
-    allocInfo.memoryTypeIndex = FindMemoryTypeIndex_(pd, req.memoryTypeBits, props);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &result.second) != VK_SUCCESS)
-		WIL_LOGERROR("Unable to allocate buffer memory");
-
-    vkBindBufferMemory(device, result.first, result.second, 0);
-
-    return result;
-}
-
-static VkCommandBuffer BeginSingleTimeCommandBuffer_(Device &device)
-{
-    VkCommandBufferAllocateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    info.commandPool = static_cast<VkCommandPool>(device.GetVkCommandPoolPtr_());
-    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    info.commandBufferCount = 1;
-
-	VkCommandBuffer cb;
-    if (vkAllocateCommandBuffers(static_cast<VkDevice>(device.GetVkDevicePtr_()), &info, &cb) != VK_SUCCESS)
-		WIL_LOGERROR("Unable to create command buffer");
-
-    VkCommandBufferBeginInfo begin_i{};
-    begin_i.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    begin_i.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(cb, &begin_i);
-
-	return cb;
-}
-
-static void EndSingleTimeCommandBuffer_(Device &device, VkCommandBuffer cb, const DeviceQueue &queue)
-{
-    vkEndCommandBuffer(cb);
-
-    VkSubmitInfo submit_i{};
-    submit_i.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_i.commandBufferCount = 1;
-    submit_i.pCommandBuffers = &cb;
-
-	auto q = static_cast<VkQueue>(queue.vkqueue);
-
-    vkQueueSubmit(q, 1, &submit_i, VK_NULL_HANDLE);
-    vkQueueWaitIdle(q);
-
-    vkFreeCommandBuffers(static_cast<VkDevice>(device.GetVkDevicePtr_()),
-			static_cast<VkCommandPool>(device.GetVkCommandPoolPtr_()), 1, &cb);
-}
-
-static void
-CopyViaStagingBuffer_(Device &device, VkDeviceSize size, void const* src, VkBuffer dst)
-{
-	auto dev = static_cast<VkDevice>(device.GetVkDevicePtr_());
-
-    auto [stage, stage_mem] = CreateBufferAndAllocateMemory_(
-			dev,
-			static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_()),
-			size,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    void* data;
-    vkMapMemory(dev, stage_mem, 0, size, 0, &data);
-    memcpy(data, src, size);
-    vkUnmapMemory(dev, stage_mem);
-
-	VkCommandBuffer cb = BeginSingleTimeCommandBuffer_(device);
-
-	VkBufferCopy buffer_copy{};
-	buffer_copy.size = size;
-	vkCmdCopyBuffer(cb, stage, dst, 1, &buffer_copy);
-
-	EndSingleTimeCommandBuffer_(device, cb, device.GetGraphicsQueue());
-
-    vkDestroyBuffer(dev, stage, nullptr);
-    vkFreeMemory(dev, stage_mem, nullptr);
+	vkDestroyBuffer(static_cast<VkDevice>(device.GetVkDevicePtr_()), static_cast<VkBuffer>(buffer), nullptr);
+	device.GetAllocator().Free(allocation);
 }
 
 VertexBuffer::VertexBuffer(Device &device, size_t size)
     : device_(&device), size_(size)
 {
-    auto [fst, snd] = CreateBufferAndAllocateMemory_(
-			static_cast<VkDevice>(device.GetVkDevicePtr_()),
-			static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_()),
-			size,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    buffer_ptr_ = fst;
-    memory_ptr_ = snd;
+	buffer_ptr_ = CreateBuffer_(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocation_);
 }
 
 VertexBuffer::~VertexBuffer()
 {
-	if (buffer_ptr_) {
-		auto dev = static_cast<VkDevice>(device_->GetVkDevicePtr_());
-		vkDestroyBuffer(dev, static_cast<VkBuffer>(buffer_ptr_), nullptr);
-		vkFreeMemory(dev, static_cast<VkDeviceMemory>(memory_ptr_), nullptr);
-	}
+	if (buffer_ptr_)
+		DestroyBuffer_(*device_, buffer_ptr_, allocation_);
 }
 
 VertexBuffer::VertexBuffer(VertexBuffer &&buffer)
 	: device_(buffer.device_), buffer_ptr_(buffer.buffer_ptr_),
-	memory_ptr_(buffer.memory_ptr_), size_(buffer.size_)
+	allocation_(buffer.allocation_), size_(buffer.size_)
 {
 	buffer.buffer_ptr_ = nullptr;
 }
@@ -156,7 +45,7 @@ VertexBuffer& VertexBuffer::operator=(VertexBuffer &&buffer)
 {
 	device_ = buffer.device_;
 	buffer_ptr_ = buffer.buffer_ptr_;
-	memory_ptr_ = buffer.memory_ptr_;
+	allocation_ = buffer.allocation_;
 	size_ = buffer.size_;
 
 	buffer.buffer_ptr_ = nullptr;
@@ -165,35 +54,37 @@ VertexBuffer& VertexBuffer::operator=(VertexBuffer &&buffer)
 
 void VertexBuffer::MapData(const void *src)
 {
-    CopyViaStagingBuffer_(*device_, size_, src, static_cast<VkBuffer>(buffer_ptr_));
+	// Frames in flight may still read the buffer
+	device_->GetGraphicsQueue().WaitIdle();
+
+	UploadBatch batch(*device_);
+	MapData(src, batch);
+	UploadToken token = batch.Submit();
+	device_->GetStagingRing().Acquire(token);
+	device_->GetStagingRing().Wait(token);
+}
+
+void VertexBuffer::MapData(const void *src, UploadBatch &batch)
+{
+	batch.CopyToBuffer(buffer_ptr_, 0, src, size_);
 }
 
 IndexBuffer::IndexBuffer(Device &device, size_t size)
     : device_(&device), size_(size)
 {
-    auto [fst, snd] = CreateBufferAndAllocateMemory_(
-			static_cast<VkDevice>(device.GetVkDevicePtr_()),
-			static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_()),
-			size,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    buffer_ptr_ = fst;
-    memory_ptr_ = snd;
+	buffer_ptr_ = CreateBuffer_(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocation_);
 }
 
 IndexBuffer::~IndexBuffer()
 {
-	if (buffer_ptr_) {
-		auto dev = static_cast<VkDevice>(device_->GetVkDevicePtr_());
-		vkDestroyBuffer(dev, static_cast<VkBuffer>(buffer_ptr_), nullptr);
-		vkFreeMemory(dev, static_cast<VkDeviceMemory>(memory_ptr_), nullptr);
-	}
+	if (buffer_ptr_)
+		DestroyBuffer_(*device_, buffer_ptr_, allocation_);
 }
 
 IndexBuffer::IndexBuffer(IndexBuffer &&buffer)
 	: device_(buffer.device_), buffer_ptr_(buffer.buffer_ptr_),
-	memory_ptr_(buffer.memory_ptr_), size_(buffer.size_)
+	allocation_(buffer.allocation_), size_(buffer.size_)
 {
 	buffer.buffer_ptr_ = nullptr;
 }
@@ -202,7 +93,7 @@ IndexBuffer& IndexBuffer::operator=(IndexBuffer &&buffer)
 {
 	device_ = buffer.device_;
 	buffer_ptr_ = buffer.buffer_ptr_;
-	memory_ptr_ = buffer.memory_ptr_;
+	allocation_ = buffer.allocation_;
 	size_ = buffer.size_;
 
 	buffer.buffer_ptr_ = nullptr;
@@ -211,37 +102,39 @@ IndexBuffer& IndexBuffer::operator=(IndexBuffer &&buffer)
 
 void IndexBuffer::MapData(const unsigned *src)
 {
-    CopyViaStagingBuffer_(*device_, size_, src, static_cast<VkBuffer>(buffer_ptr_));
+	// Frames in flight may still read the buffer
+	device_->GetGraphicsQueue().WaitIdle();
+
+	UploadBatch batch(*device_);
+	MapData(src, batch);
+	UploadToken token = batch.Submit();
+	device_->GetStagingRing().Acquire(token);
+	device_->GetStagingRing().Wait(token);
 }
 
-UniformBuffer::UniformBuffer(Device &device, size_t size)
-    : device_(&device), size_(size)
+void IndexBuffer::MapData(const unsigned *src, UploadBatch &batch)
 {
-    auto [b, m] = CreateBufferAndAllocateMemory_(
-			static_cast<VkDevice>(device.GetVkDevicePtr_()),
-			static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_()),
-			size,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    buffer_ptr_ = b;
-    memory_ptr_ = m;
+	batch.CopyToBuffer(buffer_ptr_, 0, src, size_);
+}
 
-    vkMapMemory(static_cast<VkDevice>(device.GetVkDevicePtr_()), m, 0, size, 0, &data_);
+UniformBuffer::UniformBuffer(Device &device, size_t size)
+	: device_(&device), size_(size)
+{
+	// Any host visible memory, writes are flushed when it is not coherent
+	buffer_ptr_ = CreateBuffer_(device, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, allocation_);
+	data_ = allocation_.mapped;
 }
 
 UniformBuffer::~UniformBuffer()
 {
-	if (buffer_ptr_) {
-		auto dev = static_cast<VkDevice>(device_->GetVkDevicePtr_());
-		vkDestroyBuffer(dev, static_cast<VkBuffer>(buffer_ptr_), nullptr);
-		vkFreeMemory(dev, static_cast<VkDeviceMemory>(memory_ptr_), nullptr);
-	}
+	if (buffer_ptr_)
+		DestroyBuffer_(*device_, buffer_ptr_, allocation_);
 }
 
 UniformBuffer::UniformBuffer(UniformBuffer&& buffer)
-	: device_(buffer.device_), buffer_ptr_(buffer.buffer_ptr_), memory_ptr_(buffer.memory_ptr_),
-	  size_(buffer.size_), data_(buffer.data_)
+	: device_(buffer.device_), buffer_ptr_(buffer.buffer_ptr_), allocation_(buffer.allocation_),
+	  size_(buffer.size_), data_(buffer.data_), dirty_(std::move(buffer.dirty_))
 {
 	buffer.buffer_ptr_ = nullptr;
 }
@@ -250,9 +143,10 @@ UniformBuffer &UniformBuffer::operator=(UniformBuffer &&buffer)
 {
 	device_ = buffer.device_;
 	buffer_ptr_ = buffer.buffer_ptr_;
-	memory_ptr_ = buffer.memory_ptr_;
+	allocation_ = buffer.allocation_;
 	size_ = buffer.size_;
 	data_ = buffer.data_;
+	dirty_ = std::move(buffer.dirty_);
 
 	buffer.buffer_ptr_ = nullptr;
 	return *this;
@@ -260,46 +154,74 @@ UniformBuffer &UniformBuffer::operator=(UniformBuffer &&buffer)
 
 void UniformBuffer::Update(void const* src)
 {
-	std::memcpy(data_, src, size_);
+	Update(0, size_, src);
+	Flush();
 }
 
-StorageBuffer::StorageBuffer(Device &device, size_t size)
-	: device_(&device), size_(size)
+void UniformBuffer::Update(size_t offset, size_t size, const void *src)
 {
-    auto [b, m] = CreateBufferAndAllocateMemory_(
-			static_cast<VkDevice>(device.GetVkDevicePtr_()),
-			static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_()),
-			size,
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	std::memcpy(Map(offset, size), src, size);
+}
 
-    buffer_ptr_ = b;
-    memory_ptr_ = m;
+void *UniformBuffer::Map(size_t offset, size_t size)
+{
+	WIL_ASSERT(offset + size <= size_);
+	dirty_.Add(offset, size);
+	return static_cast<char*>(data_) + offset;
+}
+
+void UniformBuffer::Flush()
+{
+	device_->GetAllocator().Flush(allocation_, dirty_.GetRanges().data(), dirty_.GetRanges().size());
+	dirty_.Clear();
+}
 
-    vkMapMemory(static_cast<VkDevice>(device.GetVkDevicePtr_()), m, 0, size, 0, &data_);
+StorageBuffer::StorageBuffer(Device &device, size_t size)
+	: device_(&device), size_(size)
+{
+	buffer_ptr_ = CreateBuffer_(device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, allocation_);
+	data_ = allocation_.mapped;
 }
 
 StorageBuffer::~StorageBuffer()
 {
-	if (buffer_ptr_) {
-		auto dev = static_cast<VkDevice>(device_->GetVkDevicePtr_());
-		vkDestroyBuffer(dev, static_cast<VkBuffer>(buffer_ptr_), nullptr);
-		vkFreeMemory(dev, static_cast<VkDeviceMemory>(memory_ptr_), nullptr);
-	}
+	if (buffer_ptr_)
+		DestroyBuffer_(*device_, buffer_ptr_, allocation_);
 }
 
 void StorageBuffer::Update(void const* src)
 {
-	std::memcpy(data_, src, size_);
+	Update(0, size_, src);
+	Flush();
+}
+
+void StorageBuffer::Update(size_t offset, size_t size, const void *src)
+{
+	std::memcpy(Map(offset, size), src, size);
+}
+
+void *StorageBuffer::Map(size_t offset, size_t size)
+{
+	WIL_ASSERT(offset + size <= size_);
+	dirty_.Add(offset, size);
+	return static_cast<char*>(data_) + offset;
+}
+
+void StorageBuffer::Flush()
+{
+	device_->GetAllocator().Flush(allocation_, dirty_.GetRanges().data(), dirty_.GetRanges().size());
+	dirty_.Clear();
 }
 
 StorageBuffer::StorageBuffer(StorageBuffer &&buffer)
 {
 	device_ = buffer.device_;
 	buffer_ptr_ = buffer.buffer_ptr_;
-	memory_ptr_ = buffer.memory_ptr_;
+	allocation_ = buffer.allocation_;
 	size_ = buffer.size_;
 	data_ = buffer.data_;
+	dirty_ = std::move(buffer.dirty_);
 
 	buffer.buffer_ptr_ = nullptr;
 }
@@ -308,17 +230,94 @@ StorageBuffer &StorageBuffer::operator=(StorageBuffer &&buffer)
 {
 	device_ = buffer.device_;
 	buffer_ptr_ = buffer.buffer_ptr_;
-	memory_ptr_ = buffer.memory_ptr_;
+	allocation_ = buffer.allocation_;
 	size_ = buffer.size_;
 	data_ = buffer.data_;
+	dirty_ = std::move(buffer.dirty_);
 
 	buffer.buffer_ptr_ = nullptr;
 	return *this;
 }
 
-static std::pair<VkImage, VkDeviceMemory>
-CreateImageAndAllocateMemory_(VkDevice dev, VkPhysicalDevice pd, uint32_t width, uint32_t height,
-		VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties)
+DynamicUniformBuffer::DynamicUniformBuffer(Device &device, size_t frame_size, uint32_t frame_count)
+	: device_(&device), frame_count_(frame_count)
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_()), &properties);
+	alignment_ = std::max<size_t>(properties.limits.minUniformBufferOffsetAlignment, 1);
+
+	// Regions start aligned so offsets of every frame are valid dynamic offsets
+	frame_size_ = (frame_size + alignment_ - 1) & ~(alignment_ - 1);
+
+	buffer_ptr_ = CreateBuffer_(device, frame_size_ * frame_count, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, allocation_);
+	data_ = static_cast<char*>(allocation_.mapped);
+}
+
+DynamicUniformBuffer::~DynamicUniformBuffer()
+{
+	if (buffer_ptr_)
+		DestroyBuffer_(*device_, buffer_ptr_, allocation_);
+}
+
+DynamicUniformBuffer::DynamicUniformBuffer(DynamicUniformBuffer &&buffer)
+	: device_(buffer.device_), buffer_ptr_(buffer.buffer_ptr_), allocation_(buffer.allocation_),
+	  frame_size_(buffer.frame_size_), alignment_(buffer.alignment_), frame_count_(buffer.frame_count_),
+	  begin_(buffer.begin_), head_(buffer.head_), flushed_(buffer.flushed_), data_(buffer.data_)
+{
+	buffer.buffer_ptr_ = nullptr;
+}
+
+DynamicUniformBuffer &DynamicUniformBuffer::operator=(DynamicUniformBuffer &&buffer)
+{
+	if (buffer_ptr_)
+		DestroyBuffer_(*device_, buffer_ptr_, allocation_);
+
+	device_ = buffer.device_;
+	buffer_ptr_ = buffer.buffer_ptr_;
+	allocation_ = buffer.allocation_;
+	frame_size_ = buffer.frame_size_;
+	alignment_ = buffer.alignment_;
+	frame_count_ = buffer.frame_count_;
+	begin_ = buffer.begin_;
+	head_ = buffer.head_;
+	flushed_ = buffer.flushed_;
+	data_ = buffer.data_;
+
+	buffer.buffer_ptr_ = nullptr;
+	return *this;
+}
+
+void DynamicUniformBuffer::BeginFrame(uint32_t frame_index)
+{
+	WIL_ASSERT(frame_index < frame_count_);
+	begin_ = head_ = flushed_ = frame_index * frame_size_;
+}
+
+DynamicUniformBuffer::Allocation DynamicUniformBuffer::Allocate(size_t size)
+{
+	size_t offset = (head_ + alignment_ - 1) & ~(alignment_ - 1);
+	if (offset + size > begin_ + frame_size_)
+	{
+		WIL_LOGERROR("Dynamic uniform buffer frame of {} bytes is full", frame_size_);
+		return { nullptr, 0 };
+	}
+
+	head_ = offset + size;
+	return { data_ + offset, static_cast<uint32_t>(offset) };
+}
+
+void DynamicUniformBuffer::Flush()
+{
+	MemoryRange range = { flushed_, head_ - flushed_ };
+	if (range.size)
+		device_->GetAllocator().Flush(allocation_, &range, 1);
+	flushed_ = head_;
+}
+
+static VkImage
+CreateImage_(Device &device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
+		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryAllocation &allocation)
 {
 	VkImageCreateInfo image_ci{};
 	image_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -337,164 +336,61 @@ CreateImageAndAllocateMemory_(VkDevice dev, VkPhysicalDevice pd, uint32_t width,
 	image_ci.flags = 0; // Optional
 	
 	VkImage image;
-	if (vkCreateImage(dev, &image_ci, nullptr, &image) != VK_SUCCESS)
+	if (vkCreateImage(static_cast<VkDevice>(device.GetVkDevicePtr_()), &image_ci, nullptr, &image) != VK_SUCCESS)
 		WIL_LOGERROR("Unable to create image");
 
-	VkMemoryRequirements memreq;
-	vkGetImageMemoryRequirements(dev, image, &memreq);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memreq.size;
-	allocInfo.memoryTypeIndex = FindMemoryTypeIndex_(pd, memreq.memoryTypeBits, properties);
-
-	VkDeviceMemory image_mem;
-	if (vkAllocateMemory(dev, &allocInfo, nullptr, &image_mem) != VK_SUCCESS)
-		WIL_LOGERROR("Unable to allocate image memory");
-
-	vkBindImageMemory(dev, image, image_mem, 0);
-
-	return {image, image_mem};
-}
-
-static void TransitionImageLayout_(Device &device, VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
-{
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommandBuffer_(device);
-
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = old_layout;
-	barrier.newLayout = new_layout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destinationStage;
-
-	if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	}
-	else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	{
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	} 
-	else 
-	{
-		WIL_LOGERROR("Invalid argument in transitioning image layout");
-	}
-
-	vkCmdPipelineBarrier(
-			commandBuffer,
-			sourceStage, destinationStage,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-			);
-
-	EndSingleTimeCommandBuffer_(device, commandBuffer, device.GetGraphicsQueue());
-}
-
-static void CopyBufferToImage_(Device &device, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-{
-	VkCommandBuffer cb = BeginSingleTimeCommandBuffer_(device);
-
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = {0, 0, 0};
-	region.imageExtent = {
-		width,
-		height,
-		1
-	};
-
-	vkCmdCopyBufferToImage(
-			cb,
-			buffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&region);
-
-	EndSingleTimeCommandBuffer_(device, cb, device.GetGraphicsQueue());
+	allocation = device.GetAllocator().AllocateImage(image, properties);
+	return image;
 }
 
 Texture::Texture(Device &device, const std::string &path)
 	: device_(&device)
 {
+	UploadBatch batch(device);
+
 	int width, height, channels;
 	stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
 	VkDeviceSize size = width * height * 4;
 
 	if (!pixels) WIL_LOGERROR("Unable to load image {}", path);
 
-	Init_(device, pixels, size, width, height);
+	Init_(device, pixels, size, width, height, batch);
+	device.GetStagingRing().Acquire(batch.Submit());
 
 	stbi_image_free(pixels);
 }
 
 Texture::Texture(Device &device, const void *data, size_t size, uint32_t width, uint32_t height) : device_(&device)
 {
-	Init_(device, data, size, width, height);
+	UploadBatch batch(device);
+	Init_(device, data, size, width, height, batch);
+	device.GetStagingRing().Acquire(batch.Submit());
 }
 
-void Texture::Init_(Device &device, const void *pixels, size_t size, uint32_t width, uint32_t height)
+Texture::Texture(Device &device, const void *data, size_t size, uint32_t width, uint32_t height, UploadBatch &batch)
+	: device_(&device)
 {
+	Init_(device, data, size, width, height, batch);
+}
 
-    auto [sb, sbm] = CreateBufferAndAllocateMemory_(
-			static_cast<VkDevice>(device.GetVkDevicePtr_()),
-			static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_()),
-			size,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
+void Texture::Init_(Device &device, const void *pixels, size_t size, uint32_t width, uint32_t height, UploadBatch &batch)
+{
 	auto dev = static_cast<VkDevice>(device.GetVkDevicePtr_());
 	auto pd = static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_());
 
-	void* data;
-	vkMapMemory(dev, sbm, 0, size, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(size));
-	vkUnmapMemory(dev, sbm);
-
-
-	auto [image, mem] = CreateImageAndAllocateMemory_(
-			dev,
-			pd,
+	VkImage image = CreateImage_(
+			device,
 			width,
 			height,
 			VK_FORMAT_R8G8B8A8_SRGB,
 			VK_IMAGE_TILING_OPTIMAL,
 			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			allocation_);
 
 	image_ptr_ = image;
-	memory_ptr_ = mem;
 
-	TransitionImageLayout_(device, image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	CopyBufferToImage_(device, sb, image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
-	TransitionImageLayout_(device, image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-	vkDestroyBuffer(dev, sb, nullptr);
-	vkFreeMemory(dev, sbm, nullptr);
+	batch.CopyToImage(image, width, height, pixels, size);
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -545,7 +441,7 @@ Texture::~Texture()
 		vkDestroySampler(dev, static_cast<VkSampler>(sampler_ptr_), nullptr);
 		vkDestroyImageView(dev, static_cast<VkImageView>(image_view_ptr_), nullptr);
 		vkDestroyImage(dev, static_cast<VkImage>(image_ptr_), nullptr);
-		vkFreeMemory(dev, static_cast<VkDeviceMemory>(memory_ptr_), nullptr);
+		device_->GetAllocator().Free(allocation_);
 	}
 }
 
@@ -553,7 +449,7 @@ Texture::Texture(Texture &&tex)
 {
 	device_ = tex.device_;
 	image_ptr_ = tex.image_ptr_;
-	memory_ptr_ = tex.memory_ptr_;
+	allocation_ = tex.allocation_;
 	image_view_ptr_ = tex.image_view_ptr_;
 	sampler_ptr_ = tex.sampler_ptr_;
 
@@ -564,7 +460,7 @@ Texture &Texture::operator=(Texture &&tex)
 {
 	device_ = tex.device_;
 	image_ptr_ = tex.image_ptr_;
-	memory_ptr_ = tex.memory_ptr_;
+	allocation_ = tex.allocation_;
 	image_view_ptr_ = tex.image_view_ptr_;
 	sampler_ptr_ = tex.sampler_ptr_;
 
@@ -603,18 +499,17 @@ DepthBuffer::DepthBuffer(Device &device) : device_(device)
 
 	format_ = format;
 
-	auto [image, mem] = CreateImageAndAllocateMemory_(
-			dev,
-			pd,
+	VkImage image = CreateImage_(
+			device,
 			device.GetSwapchainExtent().x,
 			device.GetSwapchainExtent().y,
 			format,
 			VK_IMAGE_TILING_OPTIMAL,
 			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			allocation_);
 
 	image_ptr_ = image;
-	memory_ptr_ = mem;
 
 	VkImageViewCreateInfo view_ci{};
 	view_ci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -638,7 +533,7 @@ DepthBuffer::~DepthBuffer()
 	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
 	vkDestroyImageView(dev, static_cast<VkImageView>(image_view_ptr_), nullptr);
 	vkDestroyImage(dev, static_cast<VkImage>(image_ptr_), nullptr);
-    vkFreeMemory(dev, static_cast<VkDeviceMemory>(memory_ptr_), nullptr);
+	device_.GetAllocator().Free(allocation_);
 }
 
 }
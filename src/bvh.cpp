@@ -0,0 +1,223 @@
+#include <wil/bvh.hpp>
+#include <wil/log.hpp>
+
+namespace wil {
+
+// Half the surface area, cost of visiting a node in the area heuristic
+static float Area_(AABB const& box)
+{
+	Fvec3 d = box.max - box.min;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static bool ContainsBox_(AABB const& outer, AABB const& inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+		&& outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+uint32_t AABBTree::AllocateNode_()
+{
+	if (free_.empty())
+	{
+		nodes_.emplace_back();
+		return static_cast<uint32_t>(nodes_.size() - 1);
+	}
+
+	uint32_t index = free_.back();
+	free_.pop_back();
+	return index;
+}
+
+void AABBTree::FreeNode_(uint32_t index)
+{
+	nodes_[index] = Node();
+	free_.push_back(index);
+}
+
+bool AABBTree::Update(Entity entity, AABB const& box)
+{
+	uint32_t &slot = leaves_.At(entity);
+	if (slot != SparseIndex::NULL_INDEX)
+	{
+		if (nodes_[slot].entity == entity && ContainsBox_(nodes_[slot].box, box))
+			return false;
+
+		// Moved, or reusing the leaf of a destroyed entity of same index
+		RemoveLeaf_(slot);
+		nodes_[slot].entity = entity;
+	}
+	else
+	{
+		slot = AllocateNode_();
+		nodes_[slot].entity = entity;
+		nodes_[slot].height = 0;
+		++count_;
+	}
+
+	Fvec3 margin(margin_);
+	nodes_[slot].box = { box.min - margin, box.max + margin };
+	InsertLeaf_(slot);
+	return true;
+}
+
+void AABBTree::Remove(Entity entity)
+{
+	if (!Contains(entity))
+		return;
+
+	uint32_t &slot = leaves_.Slot(entity);
+	RemoveLeaf_(slot);
+	FreeNode_(slot);
+	slot = SparseIndex::NULL_INDEX;
+	--count_;
+}
+
+void AABBTree::Clear()
+{
+	for (auto const& node : nodes_)
+		if (node.height == 0)
+			leaves_.Slot(node.entity) = SparseIndex::NULL_INDEX;
+
+	nodes_.clear();
+	free_.clear();
+	root_ = NULL_NODE;
+	count_ = 0;
+}
+
+void AABBTree::InsertLeaf_(uint32_t leaf)
+{
+	if (root_ == NULL_NODE)
+	{
+		root_ = leaf;
+		nodes_[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// Descend toward the sibling of least cost, the area of the new parent
+	// plus the growth of its ancestors
+	AABB box = nodes_[leaf].box;
+	uint32_t index = root_;
+	while (nodes_[index].height > 0)
+	{
+		auto const& node = nodes_[index];
+		float area = Area_(node.box);
+		float combined = Area_(Merge(node.box, box));
+
+		float cost = 2.f * combined;
+		float inheritance = 2.f * (combined - area);
+
+		auto child_cost = [&](uint32_t child) {
+			auto const& c = nodes_[child];
+			float merged = Area_(Merge(c.box, box));
+			return (c.height == 0 ? merged : merged - Area_(c.box)) + inheritance;
+		};
+		float left_cost = child_cost(node.left);
+		float right_cost = child_cost(node.right);
+
+		if (cost < left_cost && cost < right_cost)
+			break;
+		index = left_cost < right_cost ? node.left : node.right;
+	}
+
+	// New parent of the sibling and the leaf
+	uint32_t sibling = index;
+	uint32_t old_parent = nodes_[sibling].parent;
+	uint32_t parent = AllocateNode_();
+
+	auto &p = nodes_[parent];
+	p.parent = old_parent;
+	p.left = sibling;
+	p.right = leaf;
+	nodes_[sibling].parent = parent;
+	nodes_[leaf].parent = parent;
+
+	if (old_parent == NULL_NODE)
+		root_ = parent;
+	else if (nodes_[old_parent].left == sibling)
+		nodes_[old_parent].left = parent;
+	else
+		nodes_[old_parent].right = parent;
+
+	Refit_(parent);
+}
+
+void AABBTree::RemoveLeaf_(uint32_t leaf)
+{
+	if (leaf == root_)
+	{
+		root_ = NULL_NODE;
+		return;
+	}
+
+	uint32_t parent = nodes_[leaf].parent;
+	uint32_t grand_parent = nodes_[parent].parent;
+	uint32_t sibling = nodes_[parent].left == leaf ? nodes_[parent].right : nodes_[parent].left;
+
+	// The sibling takes the place of the parent
+	nodes_[sibling].parent = grand_parent;
+	if (grand_parent == NULL_NODE)
+		root_ = sibling;
+	else if (nodes_[grand_parent].left == parent)
+		nodes_[grand_parent].left = sibling;
+	else
+		nodes_[grand_parent].right = sibling;
+
+	FreeNode_(parent);
+	nodes_[leaf].parent = NULL_NODE;
+	Refit_(grand_parent);
+}
+
+void AABBTree::Refit_(uint32_t index)
+{
+	while (index != NULL_NODE)
+	{
+		auto &node = nodes_[index];
+		node.box = Merge(nodes_[node.left].box, nodes_[node.right].box);
+		node.height = 1 + std::max(nodes_[node.left].height, nodes_[node.right].height);
+
+		index = nodes_[Balance_(index)].parent;
+	}
+}
+
+uint32_t AABBTree::Balance_(uint32_t a)
+{
+	uint32_t left = nodes_[a].left, right = nodes_[a].right;
+	int32_t balance = nodes_[right].height - nodes_[left].height;
+	if (balance >= -1 && balance <= 1)
+		return a;
+
+	// Promote the taller child p, a keeps the other child and the shorter
+	// child of p
+	uint32_t p = balance > 1 ? right : left;
+	uint32_t other = balance > 1 ? left : right;
+	uint32_t f = nodes_[p].left, g = nodes_[p].right;
+	if (nodes_[f].height < nodes_[g].height)
+		std::swap(f, g);
+
+	uint32_t parent = nodes_[a].parent;
+	nodes_[p].parent = parent;
+	if (parent == NULL_NODE)
+		root_ = p;
+	else if (nodes_[parent].left == a)
+		nodes_[parent].left = p;
+	else
+		nodes_[parent].right = p;
+
+	auto &na = nodes_[a];
+	na.parent = p;
+	na.left = other;
+	na.right = g;
+	na.box = Merge(nodes_[other].box, nodes_[g].box);
+	na.height = 1 + std::max(nodes_[other].height, nodes_[g].height);
+	nodes_[g].parent = a;
+
+	auto &np = nodes_[p];
+	np.left = a;
+	np.right = f;
+	np.box = Merge(na.box, nodes_[f].box);
+	np.height = 1 + std::max(na.height, nodes_[f].height);
+	return p;
+}
+
+}
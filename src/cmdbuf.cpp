@@ -102,7 +102,8 @@ void CmdDraw::BindIndexBuffer(const IndexBuffer &buffer)
     vkCmdBindIndexBuffer(static_cast<VkCommandBuffer>(buffer_.buffer_ptr_), b, 0, VK_INDEX_TYPE_UINT32);
 }
 
-void CmdDraw::BindDescriptorSets(Pipeline &pipeline, int first_set, DescriptorSet *sets, size_t count)
+void CmdDraw::BindDescriptorSets(Pipeline &pipeline, int first_set, DescriptorSet *sets, size_t count,
+		const uint32_t *dynamic_offsets, size_t dynamic_count)
 {
 	std::vector<VkDescriptorSet> vksets;
 	vksets.reserve(count);
@@ -113,7 +114,7 @@ void CmdDraw::BindDescriptorSets(Pipeline &pipeline, int first_set, DescriptorSe
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			static_cast<VkPipelineLayout>(pipeline.GetVkPipelineLayoutPtr_()),
 			first_set, count,
-			vksets.data(), 0, nullptr);
+			vksets.data(), dynamic_count, dynamic_offsets);
 }
 
 // defined in pipeline.cpp
@@ -3,6 +3,8 @@
 #include <wil/pipeline.hpp>
 #include <wil/buffer.hpp>
 #include <wil/descriptor.hpp>
+#include <wil/memory.hpp>
+#include <wil/upload.hpp>
 
 #include <array>
 #include <vector>
@@ -41,6 +43,8 @@ void Device::RecreateSwapchain(Window *window, Ivec2 fbsize, bool vsync)
 Device::Device(VendorPtr vkinst, VendorPtr vksurface, Ivec2 fbsize, bool vsync)
 {
 	InitDevice_(vkinst, vksurface);
+	allocator_ = new MemoryAllocator(*this);
+	staging_ring_ = new StagingRing(*this);
 	InitSwapchain_(vksurface, fbsize, vsync);
 	InitCommandPool_();
 	depth_buffer_ = new DepthBuffer(*this);
@@ -94,10 +98,29 @@ void Device::InitDevice_(VendorPtr vkinst, VendorPtr vksurface)
 		WIL_LOGFATAL("The primary physical device does not support graphics or present operation");
 	}
 
+	// Uploads prefer a family dedicated to transfers, usually backed by DMA
+	// engines which copy without stalling rendering, then any family
+	// without graphics, then the graphics queue itself
+	transfer_queue_.family_index = graphics_queue_.family_index;
+	int transfer_score = 0;
+	for (uint32_t i = 0; i < families.size(); i++)
+	{
+		VkQueueFlags flags = families[i].queueFlags;
+		if (!(flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) || (flags & VK_QUEUE_GRAPHICS_BIT))
+			continue;
+
+		int score = flags & VK_QUEUE_COMPUTE_BIT ? 1 : 2;
+		if (score > transfer_score) {
+			transfer_queue_.family_index = i;
+			transfer_score = score;
+		}
+	}
+
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
     float priority = 1.0f;
 
-    for (uint32_t index : std::unordered_set{graphics_queue_.family_index, present_queue_.family_index})
+    for (uint32_t index : std::unordered_set{graphics_queue_.family_index, present_queue_.family_index,
+			transfer_queue_.family_index})
     {
         VkDeviceQueueCreateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -110,8 +133,14 @@ void Device::InitDevice_(VendorPtr vkinst, VendorPtr vksurface)
     VkPhysicalDeviceFeatures device_features{};
     device_features.samplerAnisotropy = VK_TRUE;
 
+	// Uploads signal a timeline semaphore
+	VkPhysicalDeviceVulkan12Features features_12{};
+	features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features_12.timelineSemaphore = VK_TRUE;
+
     VkDeviceCreateInfo device_ci{};
     device_ci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_ci.pNext = &features_12;
     device_ci.pQueueCreateInfos = queue_create_infos.data();
     device_ci.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
     device_ci.pEnabledFeatures = &device_features;
@@ -137,6 +166,8 @@ void Device::InitDevice_(VendorPtr vkinst, VendorPtr vksurface)
 			reinterpret_cast<VkQueue*>(&graphics_queue_.vkqueue));
     vkGetDeviceQueue(device, present_queue_.family_index, 0,
 			reinterpret_cast<VkQueue*>(&present_queue_.vkqueue));
+    vkGetDeviceQueue(device, transfer_queue_.family_index, 0,
+			reinterpret_cast<VkQueue*>(&transfer_queue_.vkqueue));
 }
 
 static VkSurfaceFormatKHR ChooseSurfaceFormat_(VkPhysicalDevice device, VkSurfaceKHR surface)
@@ -392,6 +423,8 @@ Device::~Device()
 		vkDestroyFramebuffer(device, static_cast<VkFramebuffer>(fb), nullptr);
     vkDestroyRenderPass(device, static_cast<VkRenderPass>(render_pass_ptr_), nullptr);
 	delete depth_buffer_;
+	delete staging_ring_;
+	delete allocator_;
 	vkDestroyCommandPool(device, static_cast<VkCommandPool>(pool_ptr_), nullptr);
     for (auto view : image_views_ptr_)
         vkDestroyImageView(device, static_cast<VkImageView>(view), nullptr);
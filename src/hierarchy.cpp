@@ -0,0 +1,229 @@
+#include <wil/hierarchy.hpp>
+#include <wil/jobs.hpp>
+#include <wil/transform.hpp>
+#include <wil/log.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace wil {
+
+TransformHierarchy::TransformHierarchy(Registry &registry) : registry_(registry)
+{
+	registry.RegisterEntityView<TransformComponent, HierarchyComponent>(nodes_view_);
+	registry.RegisterEntityView<TransformComponent>(transforms_view_);
+}
+
+void TransformHierarchy::Prepare_()
+{
+	uint32_t since = version_;
+	version_ = registry_.Tick();
+
+	// Entities gaining or losing a transform may be parents, reparenting
+	// shows as a changed HierarchyComponent
+	bool rebuild = nodes_view_.revision != nodes_revision_
+		|| (transforms_view_.revision != transforms_revision_ && ParentsChanged_(since));
+
+	if (!rebuild)
+		registry_.Each<Changed<HierarchyComponent>>(since, [&rebuild](Entity, auto&) { rebuild = true; });
+
+	nodes_revision_ = nodes_view_.revision;
+	transforms_revision_ = transforms_view_.revision;
+
+	if (rebuild)
+		return Rebuild_();
+
+	std::fill(dirty_.begin(), dirty_.end(), 0);
+	registry_.Each<Changed<TransformComponent>>(since, [this](Entity e, auto&) {
+		if (Contains(e))
+			dirty_[slots_[EntityIndex(e)]] = 1;
+	});
+
+	if (std::find(dirty_.begin(), dirty_.end(), 1) != dirty_.end())
+		++revision;
+}
+
+bool TransformHierarchy::ParentsChanged_(uint32_t since)
+{
+	for (Entity e : parent_roots_)
+		if (!registry_.IsAlive(e) || !registry_.HasComponents<TransformComponent>(e))
+			return true;
+
+	if (missing_parents_.empty())
+		return false;
+
+	bool changed = false;
+	registry_.Each<Added<TransformComponent>>(since, [&](Entity e, auto&) {
+		changed |= std::binary_search(missing_parents_.begin(), missing_parents_.end(), e);
+	});
+	return changed;
+}
+
+void TransformHierarchy::Rebuild_()
+{
+	for (Entity e : entities_)
+		slots_[EntityIndex(e)] = NO_SLOT;
+
+	// Gather the nodes and their parents, slots_ temporarily holds the
+	// position in this unsorted list
+	std::vector<Entity> nodes(nodes_view_.begin(), nodes_view_.end());
+	std::vector<uint32_t> parents(nodes.size(), NO_SLOT);
+
+	auto slot = [this](Entity e) -> uint32_t& {
+		uint32_t index = EntityIndex(e);
+		if (index >= slots_.size())
+			slots_.resize(index + 1, NO_SLOT);
+		return slots_[index];
+	};
+
+	for (uint32_t i = 0; i < nodes.size(); ++i)
+		slot(nodes[i]) = i;
+
+	parent_roots_.clear();
+	missing_parents_.clear();
+	for (size_t i = 0, count = nodes.size(); i < count; ++i)
+	{
+		Entity parent = registry_.GetComponent<HierarchyComponent>(nodes[i]).parent;
+		if (parent == NULL_ENTITY || !registry_.IsAlive(parent))
+			continue;
+
+		if (!registry_.HasComponents<TransformComponent>(parent))
+		{
+			missing_parents_.push_back(parent);
+			continue;
+		}
+
+		// Parents without HierarchyComponent are roots
+		uint32_t &parent_slot = slot(parent);
+		if (parent_slot == NO_SLOT)
+		{
+			parent_slot = static_cast<uint32_t>(nodes.size());
+			nodes.push_back(parent);
+			parents.push_back(NO_SLOT);
+			parent_roots_.push_back(parent);
+		}
+		parents[i] = parent_slot;
+	}
+	std::sort(missing_parents_.begin(), missing_parents_.end());
+
+	// Depth of every node, walking up to the first node of known depth
+	static constexpr uint32_t UNKNOWN = UINT32_MAX, VISITING = UINT32_MAX - 1;
+	std::vector<uint32_t> depths(nodes.size(), UNKNOWN);
+	std::vector<uint32_t> path;
+	uint32_t max_depth = 0;
+
+	for (uint32_t i = 0; i < nodes.size(); ++i)
+	{
+		uint32_t node = i;
+		for (;;)
+		{
+			while (depths[node] == UNKNOWN)
+			{
+				depths[node] = VISITING;
+				path.push_back(node);
+				if (parents[node] == NO_SLOT)
+					break;
+				node = parents[node];
+			}
+
+			if (depths[node] != VISITING || parents[node] == NO_SLOT)
+				break;
+
+			// Back on the path, break the cycle and walk again
+			WIL_LOGERROR("Cycle in the transform hierarchy, entity {} made a root", nodes[node]);
+			parents[node] = NO_SLOT;
+			for (uint32_t visited : path)
+				depths[visited] = UNKNOWN;
+			path.clear();
+			node = i;
+		}
+
+		// Either the walk stopped on a root, last on the path, or below a
+		// node of known depth
+		uint32_t depth = depths[node] == VISITING ? 0 : depths[node] + 1;
+		for (auto it = path.rbegin(); it != path.rend(); ++it)
+			depths[*it] = depth++;
+		max_depth = std::max(max_depth, depth - 1);
+		path.clear();
+	}
+
+	// Counting sort by depth
+	levels_.assign(max_depth + 2, 0);
+	for (uint32_t depth : depths)
+		++levels_[depth + 1];
+	for (size_t d = 1; d < levels_.size(); ++d)
+		levels_[d] += levels_[d - 1];
+
+	std::vector<size_t> cursor(levels_.begin(), levels_.end() - 1);
+	std::vector<uint32_t> sorted(nodes.size());
+	for (uint32_t i = 0; i < nodes.size(); ++i)
+		sorted[i] = static_cast<uint32_t>(cursor[depths[i]]++);
+
+	entities_.resize(nodes.size());
+	parents_.resize(nodes.size());
+	for (uint32_t i = 0; i < nodes.size(); ++i)
+	{
+		entities_[sorted[i]] = nodes[i];
+		parents_[sorted[i]] = parents[i] == NO_SLOT ? NO_SLOT : sorted[parents[i]];
+		slots_[EntityIndex(nodes[i])] = sorted[i];
+	}
+
+	dirty_.assign(nodes.size(), 1);
+	worlds_.resize(nodes.size());
+	++revision;
+}
+
+void TransformHierarchy::UpdateRange_(size_t first, size_t last)
+{
+	for (size_t i = first; i < last; ++i)
+	{
+		uint32_t parent = parents_[i];
+		if (parent != NO_SLOT)
+			dirty_[i] |= dirty_[parent];
+		if (!dirty_[i])
+			continue;
+
+		auto const& tc = registry_.GetComponent<TransformComponent>(entities_[i]);
+		Fmat4 local = ComposeTRS(tc.position, tc.rotation, tc.size);
+		worlds_[i] = parent == NO_SLOT ? local : worlds_[parent] * local;
+	}
+}
+
+void TransformHierarchy::Update()
+{
+	Prepare_();
+
+	for (size_t d = 0; d + 1 < levels_.size(); ++d)
+		UpdateRange_(levels_[d], levels_[d + 1]);
+}
+
+void TransformHierarchy::Update(ThreadPool &pool, size_t grain)
+{
+	Prepare_();
+
+	grain = std::max<size_t>(grain, 1);
+	for (size_t d = 0; d + 1 < levels_.size(); ++d)
+	{
+		size_t first = levels_[d], last = levels_[d + 1];
+		size_t ranges = (last - first + grain - 1) / grain;
+		if (ranges <= 1)
+		{
+			UpdateRange_(first, last);
+			continue;
+		}
+
+		// A level only reads the previous ones, its ranges are independent
+		std::atomic<size_t> remaining = ranges;
+		for (size_t r = 0; r < ranges; ++r)
+		{
+			pool.Submit([&, r] {
+				size_t begin = first + r * grain;
+				UpdateRange_(begin, std::min(begin + grain, last));
+				--remaining;
+			});
+		}
+		pool.WaitFor(remaining);
+	}
+}
+
+}
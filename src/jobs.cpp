@@ -0,0 +1,113 @@
+#include <wil/jobs.hpp>
+
+#include <algorithm>
+
+namespace wil {
+
+// Pool and queue of the worker running on the current thread.
+static thread_local const ThreadPool *current_pool_ = nullptr;
+static thread_local size_t current_queue_ = 0;
+
+ThreadPool::ThreadPool(unsigned threads) : pending_(0), stop_(false)
+{
+	if (!threads)
+		threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	for (unsigned i = 0; i <= threads; ++i)
+		queues_.emplace_back(std::make_unique<Queue>());
+
+	workers_.reserve(threads);
+	for (unsigned i = 0; i < threads; ++i)
+		workers_.emplace_back([this, i] { WorkerLoop_(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(sleep_mutex_);
+		stop_ = true;
+	}
+	sleep_cv_.notify_all();
+
+	for (auto &worker : workers_)
+		worker.join();
+}
+
+size_t ThreadPool::GetQueueIndex_() const
+{
+	return current_pool_ == this ? current_queue_ : workers_.size();
+}
+
+void ThreadPool::Submit(Job job)
+{
+	auto &queue = *queues_[GetQueueIndex_()];
+	{
+		std::lock_guard lock(queue.mutex);
+		queue.jobs.emplace_back(std::move(job));
+	}
+
+	{
+		std::lock_guard lock(sleep_mutex_);
+		++pending_;
+	}
+	sleep_cv_.notify_one();
+}
+
+bool ThreadPool::TryRunJob_(size_t self)
+{
+	Job job;
+
+	for (size_t i = 0; i < queues_.size() && !job; ++i)
+	{
+		size_t index = (self + i) % queues_.size();
+		auto &queue = *queues_[index];
+		std::lock_guard lock(queue.mutex);
+
+		if (queue.jobs.empty())
+			continue;
+
+		if (index == self) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		} else {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+	}
+
+	if (!job)
+		return false;
+
+	--pending_;
+	job();
+	return true;
+}
+
+void ThreadPool::WorkerLoop_(size_t index)
+{
+	current_pool_ = this;
+	current_queue_ = index;
+
+	while (true)
+	{
+		if (TryRunJob_(index))
+			continue;
+
+		std::unique_lock lock(sleep_mutex_);
+		sleep_cv_.wait(lock, [this] { return stop_ || pending_ > 0; });
+		if (stop_)
+			return;
+	}
+}
+
+void ThreadPool::WaitFor(const std::atomic<size_t> &counter)
+{
+	size_t self = GetQueueIndex_();
+	while (counter > 0)
+	{
+		if (!TryRunJob_(self))
+			std::this_thread::yield();
+	}
+}
+
+}
@@ -0,0 +1,431 @@
+#include <wil/memory.hpp>
+#include <wil/device.hpp>
+#include <wil/log.hpp>
+
+#include <algorithm>
+#include <iterator>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+namespace wil {
+
+FreeListAllocator::FreeListAllocator(uint64_t size) : size_(size)
+{
+	if (size)
+		InsertFree_(0, size);
+}
+
+void FreeListAllocator::InsertFree_(uint64_t offset, uint64_t size)
+{
+	free_by_offset_.emplace(offset, size);
+	free_by_size_.emplace(size, offset);
+}
+
+void FreeListAllocator::EraseFree_(std::map<uint64_t, uint64_t>::iterator it)
+{
+	auto [first, last] = free_by_size_.equal_range(it->second);
+	for (; first != last; ++first)
+	{
+		if (first->second == it->first)
+		{
+			free_by_size_.erase(first);
+			break;
+		}
+	}
+	free_by_offset_.erase(it);
+}
+
+uint64_t FreeListAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	WIL_ASSERT(size && alignment && !(alignment & (alignment - 1)));
+
+	// Smallest free range holding size bytes once aligned
+	for (auto it = free_by_size_.lower_bound(size); it != free_by_size_.end(); ++it)
+	{
+		auto [range_size, range_offset] = *it;
+		uint64_t offset = (range_offset + alignment - 1) & ~(alignment - 1);
+		uint64_t padding = offset - range_offset;
+		if (padding + size > range_size)
+			continue;
+
+		EraseFree_(free_by_offset_.find(range_offset));
+
+		// Padding and tail stay free
+		if (padding)
+			InsertFree_(range_offset, padding);
+		if (padding + size < range_size)
+			InsertFree_(offset + size, range_size - padding - size);
+
+		allocated_.emplace(offset, size);
+		used_ += size;
+		return offset;
+	}
+
+	return INVALID_OFFSET;
+}
+
+void FreeListAllocator::Free(uint64_t offset)
+{
+	auto allocation = allocated_.find(offset);
+	WIL_ASSERT(allocation != allocated_.end());
+	uint64_t size = allocation->second;
+	allocated_.erase(allocation);
+	used_ -= size;
+
+	// Merge with the free neighbours
+	auto next = free_by_offset_.lower_bound(offset);
+	if (next != free_by_offset_.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			size += prev->second;
+			EraseFree_(prev);
+		}
+	}
+
+	if (next != free_by_offset_.end() && offset + size == next->first)
+	{
+		size += next->second;
+		EraseFree_(next);
+	}
+
+	InsertFree_(offset, size);
+}
+
+void DirtyRanges::Add(uint64_t offset, uint64_t size)
+{
+	if (!size)
+		return;
+
+	uint64_t end = offset + size;
+
+	// Ranges overlapping or touching [offset, end) are merged into it
+	auto first = std::lower_bound(ranges_.begin(), ranges_.end(), offset,
+			[](MemoryRange const& r, uint64_t o) { return r.offset + r.size < o; });
+	auto last = first;
+	for (; last != ranges_.end() && last->offset <= end; ++last)
+	{
+		offset = std::min(offset, last->offset);
+		end = std::max(end, last->offset + last->size);
+	}
+	ranges_.insert(ranges_.erase(first, last), { offset, end - offset });
+
+	if (ranges_.size() <= max_count_)
+		return;
+
+	// Merge the two ranges with the smallest gap in between
+	size_t best = 0;
+	uint64_t best_gap = UINT64_MAX;
+	for (size_t i = 0; i + 1 < ranges_.size(); ++i)
+	{
+		uint64_t gap = ranges_[i + 1].offset - (ranges_[i].offset + ranges_[i].size);
+		if (gap < best_gap)
+		{
+			best_gap = gap;
+			best = i;
+		}
+	}
+	ranges_[best].size = ranges_[best + 1].offset + ranges_[best + 1].size - ranges_[best].offset;
+	ranges_.erase(ranges_.begin() + best + 1);
+}
+
+uint64_t DirtyRanges::GetBytes() const
+{
+	uint64_t bytes = 0;
+	for (auto const& r : ranges_)
+		bytes += r.size;
+	return bytes;
+}
+
+MemoryAllocator::MemoryAllocator(Device &device, uint64_t block_size)
+	: device_(device), block_size_(block_size)
+{
+	auto pd = static_cast<VkPhysicalDevice>(device.GetVkPhysicalDevicePtr_());
+
+	VkPhysicalDeviceMemoryProperties mp;
+	vkGetPhysicalDeviceMemoryProperties(pd, &mp);
+	for (uint32_t i = 0; i < mp.memoryTypeCount; i++)
+		type_properties_.push_back(mp.memoryTypes[i].propertyFlags);
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(pd, &properties);
+	non_coherent_atom_size_ = std::max<uint64_t>(properties.limits.nonCoherentAtomSize, 1);
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	for (auto &pool : pools_)
+	{
+		for (auto &block : pool.blocks)
+		{
+			if (block.ranges && block.ranges->GetAllocationCount())
+				WIL_LOGWARN("{} allocations of memory type {} are still alive", block.ranges->GetAllocationCount(), pool.type_index);
+			FreeBlock_(block);
+		}
+	}
+}
+
+uint32_t MemoryAllocator::FindMemoryType_(uint32_t type_bits, uint32_t properties) const
+{
+	for (uint32_t i = 0; i < type_properties_.size(); i++)
+		if (type_bits & (1 << i) && (type_properties_[i] & properties) == properties)
+			return i;
+
+	WIL_LOGERROR("No memory type supports the properties {}", properties);
+	return UINT32_MAX;
+}
+
+uint32_t MemoryAllocator::GetPool_(uint32_t type_index, Kind kind)
+{
+	for (uint32_t i = 0; i < pools_.size(); ++i)
+		if (pools_[i].type_index == type_index && pools_[i].kind == kind)
+			return i;
+
+	bool coherent = type_properties_[type_index] & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	pools_.push_back({ type_index, kind, coherent, {} });
+	return static_cast<uint32_t>(pools_.size() - 1);
+}
+
+uint32_t MemoryAllocator::AllocateBlock_(Pool &pool, uint64_t size, bool dedicated)
+{
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+
+	VkMemoryAllocateInfo alloc_i{};
+	alloc_i.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_i.allocationSize = size;
+	alloc_i.memoryTypeIndex = pool.type_index;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(dev, &alloc_i, nullptr, &memory) != VK_SUCCESS)
+		return UINT32_MAX;
+
+	Block block = { memory, nullptr, dedicated ? nullptr : std::make_unique<FreeListAllocator>(size) };
+	if (type_properties_[pool.type_index] & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		vkMapMemory(dev, memory, 0, VK_WHOLE_SIZE, 0, &block.mapped);
+
+	// Reuse the slot of a released block, indices held by allocations stay
+	// valid
+	for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+	{
+		if (!pool.blocks[i].memory)
+		{
+			pool.blocks[i] = std::move(block);
+			return i;
+		}
+	}
+
+	pool.blocks.push_back(std::move(block));
+	return static_cast<uint32_t>(pool.blocks.size() - 1);
+}
+
+void MemoryAllocator::FreeBlock_(Block &block)
+{
+	if (!block.memory)
+		return;
+
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+	if (block.mapped)
+		vkUnmapMemory(dev, static_cast<VkDeviceMemory>(block.memory));
+	vkFreeMemory(dev, static_cast<VkDeviceMemory>(block.memory), nullptr);
+	block = { nullptr, nullptr, nullptr };
+}
+
+MemoryAllocation
+MemoryAllocator::Allocate(uint64_t size, uint64_t alignment, uint32_t type_bits, uint32_t properties, Kind kind)
+{
+	MemoryAllocation result;
+	uint32_t type_index = FindMemoryType_(type_bits, properties);
+	if (type_index == UINT32_MAX)
+		return result;
+
+	std::lock_guard lock(mutex_);
+	result.pool = GetPool_(type_index, kind);
+	Pool &pool = pools_[result.pool];
+
+	auto fill = [&](uint32_t block_index, uint64_t offset) {
+		Block &block = pool.blocks[block_index];
+		result.memory = block.memory;
+		result.offset = offset;
+		result.size = size;
+		result.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+		result.block = block_index;
+		return result;
+	};
+
+	// Resources larger than half a block get their own memory
+	if (size > block_size_ / 2)
+	{
+		uint32_t index = AllocateBlock_(pool, size, true);
+		if (index == UINT32_MAX)
+		{
+			WIL_LOGERROR("Unable to allocate {} bytes of memory type {}", size, type_index);
+			return result;
+		}
+		return fill(index, 0);
+	}
+
+	for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+	{
+		Block &block = pool.blocks[i];
+		if (!block.ranges)
+			continue;
+
+		uint64_t offset = block.ranges->Allocate(size, alignment);
+		if (offset != FreeListAllocator::INVALID_OFFSET)
+			return fill(i, offset);
+	}
+
+	uint32_t index = AllocateBlock_(pool, block_size_, false);
+	if (index == UINT32_MAX)
+	{
+		WIL_LOGERROR("Unable to allocate a block of {} bytes of memory type {}", block_size_, type_index);
+		return result;
+	}
+	return fill(index, pool.blocks[index].ranges->Allocate(size, alignment));
+}
+
+void MemoryAllocator::Free(MemoryAllocation const& allocation)
+{
+	if (!allocation.memory)
+		return;
+
+	std::lock_guard lock(mutex_);
+	Pool &pool = pools_[allocation.pool];
+	Block &block = pool.blocks[allocation.block];
+	if (!block.ranges)
+		return FreeBlock_(block);
+
+	block.ranges->Free(allocation.offset);
+	if (block.ranges->GetAllocationCount())
+		return;
+
+	// Keep a single empty block per pool, so a resource freed and created
+	// again every frame does not allocate device memory each time
+	for (auto &other : pool.blocks)
+		if (&other != &block && other.ranges && !other.ranges->GetAllocationCount())
+			return FreeBlock_(block);
+}
+
+VendorPtr MemoryAllocator::CreateBuffer(uint64_t size, uint32_t usage, uint32_t properties, MemoryAllocation &allocation)
+{
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+
+	VkBufferCreateInfo buffer_ci{};
+	buffer_ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_ci.size = size;
+	buffer_ci.usage = usage;
+	buffer_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkBuffer buffer;
+	if (vkCreateBuffer(dev, &buffer_ci, nullptr, &buffer) != VK_SUCCESS)
+	{
+		WIL_LOGERROR("Unable to create buffer");
+		return nullptr;
+	}
+
+	VkMemoryRequirements req;
+	vkGetBufferMemoryRequirements(dev, buffer, &req);
+
+	allocation = Allocate(req.size, req.alignment, req.memoryTypeBits, properties, KIND_BUFFER);
+	if (!allocation.memory)
+		WIL_LOGERROR("Unable to allocate buffer memory");
+	else
+		vkBindBufferMemory(dev, buffer, static_cast<VkDeviceMemory>(allocation.memory), allocation.offset);
+
+	return buffer;
+}
+
+MemoryAllocation MemoryAllocator::AllocateImage(VendorPtr image, uint32_t properties)
+{
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+
+	VkMemoryRequirements req;
+	vkGetImageMemoryRequirements(dev, static_cast<VkImage>(image), &req);
+
+	MemoryAllocation allocation = Allocate(req.size, req.alignment, req.memoryTypeBits, properties, KIND_IMAGE);
+	if (!allocation.memory)
+		WIL_LOGERROR("Unable to allocate image memory");
+	else
+		vkBindImageMemory(dev, static_cast<VkImage>(image), static_cast<VkDeviceMemory>(allocation.memory), allocation.offset);
+
+	return allocation;
+}
+
+bool MemoryAllocator::IsCoherent(MemoryAllocation const& allocation) const
+{
+	std::lock_guard lock(mutex_);
+	return pools_[allocation.pool].coherent;
+}
+
+void MemoryAllocator::Flush(MemoryAllocation const& allocation, MemoryRange const *ranges, size_t count)
+{
+	if (!allocation.memory || !count)
+		return;
+
+	uint64_t memory_end;
+	{
+		std::lock_guard lock(mutex_);
+		Pool const& pool = pools_[allocation.pool];
+		if (pool.coherent)
+			return;
+
+		// Dedicated allocations span their whole memory
+		memory_end = pool.blocks[allocation.block].ranges ? block_size_ : allocation.size;
+	}
+
+	uint64_t atom = non_coherent_atom_size_;
+
+	std::vector<VkMappedMemoryRange> vkranges(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t begin = (allocation.offset + ranges[i].offset) / atom * atom;
+		uint64_t end = (allocation.offset + ranges[i].offset + ranges[i].size + atom - 1) / atom * atom;
+
+		auto &r = vkranges[i];
+		r.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		r.memory = static_cast<VkDeviceMemory>(allocation.memory);
+		r.offset = begin;
+		// Rounding up may pass the end of the memory, which only the whole
+		// size can cover
+		r.size = end < memory_end ? end - begin : VK_WHOLE_SIZE;
+	}
+
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+	if (vkFlushMappedMemoryRanges(dev, static_cast<uint32_t>(count), vkranges.data()) != VK_SUCCESS)
+		WIL_LOGERROR("Unable to flush {} mapped memory ranges", count);
+}
+
+MemoryStats MemoryAllocator::GetStats() const
+{
+	std::lock_guard lock(mutex_);
+
+	MemoryStats stats;
+	for (auto const& pool : pools_)
+	{
+		for (auto const& block : pool.blocks)
+		{
+			if (!block.memory)
+				continue;
+
+			++stats.block_count;
+			if (!block.ranges)
+			{
+				// Dedicated allocations are fully used
+				++stats.allocation_count;
+				continue;
+			}
+
+			stats.allocation_count += block.ranges->GetAllocationCount();
+			stats.reserved_bytes += block.ranges->GetSize();
+			stats.used_bytes += block.ranges->GetUsed();
+			stats.free_range_count += block.ranges->GetFreeRangeCount();
+			stats.largest_free_range = std::max(stats.largest_free_range, block.ranges->GetLargestFreeRange());
+		}
+	}
+
+	return stats;
+}
+
+}
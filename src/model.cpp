@@ -40,7 +40,8 @@ static tinygltf::Model LoadGLTFModel_(const std::string& filename)
 }
 
 static std::vector<Mesh>
-ExtractMeshes_(const tinygltf::Model& model, Device &device, size_t vsize, const Model::VertexHandler &handler)
+ExtractMeshes_(const tinygltf::Model& model, Device &device, size_t vsize, const Model::VertexHandler &handler,
+		UploadBatch &batch)
 {
 	std::vector<Mesh> result;
 	result.reserve(model.meshes.size());
@@ -73,6 +74,8 @@ ExtractMeshes_(const tinygltf::Model& model, Device &device, size_t vsize, const
 			std::vector<char> vertices_data;
 			vertices_data.resize(vsize * vertexCount);
 
+			std::vector<Fvec3> positions(vertexCount);
+
             for (size_t i = 0; i < vertexCount; ++i)
 			{
                 const float* posData = reinterpret_cast<const float*>(
@@ -86,10 +89,22 @@ ExtractMeshes_(const tinygltf::Model& model, Device &device, size_t vsize, const
 				Fvec3 normal = {normalData[0], normalData[1], normalData[2]};
 				Fvec2 texcoord = {texData[0], texData[1]};
 				handler(vertices_data.data() + i * vsize, pos, texcoord, normal);
+				positions[i] = pos;
             }
 
+			// POSITION accessors should carry their bounds, otherwise they
+			// are computed from the positions
+			if (posAccessor.minValues.size() >= 3 && posAccessor.maxValues.size() >= 3)
+			{
+				m.bounds.min = Fvec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+				m.bounds.max = Fvec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+			}
+			else
+				m.bounds = ComputeAABB(positions);
+			m.sphere = ComputeBoundingSphere(positions, m.bounds);
+
 			m.vertex_buffer = VertexBuffer(device, vsize * vertexCount);
-			m.vertex_buffer.MapData(vertices_data.data());
+			m.vertex_buffer.MapData(vertices_data.data(), batch);
 			m.draw_count = vertexCount;
 
             if (primitive.indices >= 0) {
@@ -115,7 +130,7 @@ ExtractMeshes_(const tinygltf::Model& model, Device &device, size_t vsize, const
                 }
 
 				m.index_buffer = IndexBuffer(device, sizeof(uint32_t) * indexCount);
-				m.index_buffer->MapData(indices.data());
+				m.index_buffer->MapData(indices.data(), batch);
 				m.draw_count = indexCount;
             }
         }
@@ -125,7 +140,7 @@ ExtractMeshes_(const tinygltf::Model& model, Device &device, size_t vsize, const
 }
 
 static std::vector<Texture>
-LoadTextures_(const tinygltf::Model& model, Device &device)
+LoadTextures_(const tinygltf::Model& model, Device &device, UploadBatch &batch)
 {
 	std::vector<Texture> textures;
 
@@ -140,7 +155,7 @@ LoadTextures_(const tinygltf::Model& model, Device &device)
             // Load image data
             if (!image.image.empty()) {
 				textures.emplace_back(Texture(
-							device, image.image.data(), image.width * image.height * 4, image.width, image.height));
+							device, image.image.data(), image.width * image.height * 4, image.width, image.height, batch));
             } else {
 				WIL_LOGERROR("Texture image data is empty");
             }
@@ -153,8 +168,20 @@ LoadTextures_(const tinygltf::Model& model, Device &device)
 Model::Model(Device &device, const std::string &path, size_t vertex_size, const VertexHandler &fn)
 {
 	tinygltf::Model model = LoadGLTFModel_(path);
-	meshes_ = ExtractMeshes_(model, device, vertex_size, fn);
-	textures_ = LoadTextures_(model, device);
+
+	// All buffers and textures of the model are uploaded in one submission
+	UploadBatch batch(device);
+	meshes_ = ExtractMeshes_(model, device, vertex_size, fn, batch);
+
+	for (size_t i = 0; i < meshes_.size(); ++i)
+		bounds_ = i ? Merge(bounds_, meshes_[i].bounds) : meshes_[i].bounds;
+
+	Fvec3 center = (bounds_.min + bounds_.max) * 0.5f;
+	sphere_ = { center, 0.f };
+	for (auto const& mesh : meshes_)
+		sphere_ = Merge(sphere_, mesh.sphere, center);
+	textures_ = LoadTextures_(model, device, batch);
+	upload_token_ = batch.Submit();
 }
 
 }
@@ -3,8 +3,13 @@
 #include <wil/transform.hpp>
 #include <wil/log.hpp>
 
+#include <cstddef>
+
 namespace wil {
 
+// Room of each frame in frame_uniforms_ for per pass and per draw constants
+constexpr size_t FRAME_UNIFORMS_SIZE = 64 << 10;
+
 void Camera::MoveStraight(float val)
 {
 	Fvec3 ori = {
@@ -44,7 +49,7 @@ void Camera::MoveUp(float val)
 }
 
 RenderSystem::RenderSystem(Registry& registry, Device &device)
-	: System(registry), registry_(registry), device_(device)
+	: System(registry), registry_(registry), device_(device), hierarchy_(registry)
 {
 	registry.RegisterEntityView<TransformComponent, ModelComponent>(objects_);
 	registry.RegisterEntityView<TransformComponent, PointLightComponent>(point_lights_);
@@ -53,6 +58,9 @@ RenderSystem::RenderSystem(Registry& registry, Device &device)
 	CreatePipelines_(device);
 	CreateDescriptorSetsAndUniforms_(device);
 
+	lights_.directional.dir = Fvec3(0, 1, 0);
+	lights_.directional.color = Fvec3(1.f);
+
 	camera_.position = {0.f, 3.f, -4.f};
 	camera_.h_angle = 0.f;
 	camera_.v_angle = 0.f;
@@ -102,7 +110,7 @@ void RenderSystem::CreatePipelines_(Device &device)
 	octor.push_constant_size = sizeof(ObjectPushConstant);
 
 	octor.descriptor_set_layouts.resize(2);
-	octor.descriptor_set_layouts[0].Add(0, UNIFORM_BUFFER, VERTEX_SHADER | FRAGMENT_SHADER);
+	octor.descriptor_set_layouts[0].Add(0, UNIFORM_BUFFER_DYNAMIC, VERTEX_SHADER | FRAGMENT_SHADER);
 	octor.descriptor_set_layouts[0].Add(1, STORAGE_BUFFER, FRAGMENT_SHADER);
 	octor.descriptor_set_layouts[1].Add(0, COMBINED_IMAGE_SAMPLER, FRAGMENT_SHADER);
 
@@ -121,7 +129,7 @@ void RenderSystem::CreatePipelines_(Device &device)
 	lctor.push_constant_size = sizeof(LightPushConstant);
 
 	lctor.descriptor_set_layouts.resize(1);
-	lctor.descriptor_set_layouts[0].Add(0, UNIFORM_BUFFER, VERTEX_SHADER);
+	lctor.descriptor_set_layouts[0].Add(0, UNIFORM_BUFFER_DYNAMIC, VERTEX_SHADER);
 
 	light_pipeline_ = std::make_unique<Pipeline>(lctor);
 }
@@ -135,27 +143,213 @@ void RenderSystem::CreateDescriptorSetsAndUniforms_(Device &device)
 
 	object_0_sets.resize(fif);
 	light_0_sets.resize(fif);
+	lights_uploaded_.assign(fif, false);
 
 	object_pool_->AllocateSets(0, object_0_sets.data(), fif);
 	light_pool_->AllocateSets(0, light_0_sets.data(), fif);
 
 	object_1_sets.reserve(fif);
 
-	object_0_0_uniforms.reserve(fif);
 	object_0_1_storages.reserve(fif);
-	light_0_0_uniforms.reserve(fif);
+
+	frame_uniforms_ = DynamicUniformBuffer(device, FRAME_UNIFORMS_SIZE, fif);
 
 	for (uint32_t i = 0; i < fif; ++i)
 	{
-		object_0_0_uniforms.emplace_back(device, sizeof(ObjectUniform_0_0));
 		object_0_1_storages.emplace_back(device, sizeof(ObjectStorage_0_1));
 
-		object_0_sets[i].BindUniform(0, object_0_0_uniforms[i]);
+		object_0_sets[i].BindUniformDynamic(0, frame_uniforms_, sizeof(ObjectUniform_0_0));
 		object_0_sets[i].BindStorage(1, object_0_1_storages[i]);
 
-		light_0_0_uniforms.emplace_back(device, sizeof(LightUniform_0_0));
-		light_0_sets[i].BindUniform(0, light_0_0_uniforms[i]);
+		light_0_sets[i].BindUniformDynamic(0, frame_uniforms_, sizeof(LightUniform_0_0));
+	}
+}
+
+bool RenderSystem::UpdateLights_()
+{
+	// Lights are gathered every frame and compared with the stored table
+	// instead of relying on Changed<T>, so writes through GetComponent or
+	// Each are picked up too. There are at most 2 * MAX_COUNT of them.
+	bool changed = false;
+	uint32_t pl_count = 0, sl_count = 0;
+
+	for (Entity e : point_lights_)
+	{
+		auto [tc, lc] = registry_.GetComponents<TransformComponent,PointLightComponent>(e);
+
+		ObjectPointLight light = {
+			.pos = GetWorldPosition_(e, tc),
+			.color = lc.color,
+			.linear = lc.linear,
+			.quadratic = lc.quadratic,
+		};
+		changed |= pl_count >= lights_.pl_count || lights_.points[pl_count] != light;
+		lights_.points[pl_count++] = light;
+	}
+
+	for (Entity e : spot_lights_)
+	{
+		auto [tc, lc] = registry_.GetComponents<TransformComponent,SpotLightComponent>(e);
+
+		ObjectSpotLight light = {
+			.pos = GetWorldPosition_(e, tc),
+			.dir = lc.dir,
+			.color = lc.color,
+			.cutoff = lc.cutoff,
+			.linear = lc.linear,
+			.quadratic = lc.quadratic,
+		};
+		changed |= sl_count >= lights_.sl_count || lights_.spots[sl_count] != light;
+		lights_.spots[sl_count++] = light;
+	}
+
+	changed |= pl_count != lights_.pl_count || sl_count != lights_.sl_count;
+	lights_.pl_count = pl_count, lights_.sl_count = sl_count;
+	return changed;
+}
+
+void RenderSystem::ComposeObjectModels_()
+{
+	size_t count = objects_.size();
+	object_transforms_.resize(10 * count);
+	object_pushes_.resize(count);
+
+	float *px = object_transforms_.data(), *py = px + count, *pz = py + count;
+	float *sx = pz + count, *sy = sx + count, *sz = sy + count;
+	float *qx = sz + count, *qy = qx + count, *qz = qy + count, *qw = qz + count;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto &tc = registry_.GetComponent<TransformComponent>(objects_.entities[i]);
+		px[i] = tc.position.x, py[i] = tc.position.y, pz[i] = tc.position.z;
+		sx[i] = tc.size.x, sy[i] = tc.size.y, sz[i] = tc.size.z;
+		qx[i] = tc.rotation.x, qy[i] = tc.rotation.y, qz[i] = tc.rotation.z, qw[i] = tc.rotation.w;
+	}
+
+	TransformBatch batch = { count, px, py, pz, sx, sy, sz, qx, qy, qz, qw };
+	if (count)
+		ComposeModels(batch, &object_pushes_[0].model, sizeof(ObjectPushConstant));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto &push = object_pushes_[i];
+
+		// Objects attached to a parent use their cached world matrix
+		if (hierarchy_.Contains(objects_.entities[i]))
+			push.model = hierarchy_.GetWorld(objects_.entities[i]);
+
+		Fmat4 normal = AffineInverseTranspose(push.model);
+		for (unsigned j = 0; j < 3; ++j)
+			push.normal[j] = normal[j];
+	}
+}
+
+void RenderSystem::CullObjects_(Fmat4 const& view_proj)
+{
+	size_t count = objects_.size();
+	object_visible_.assign(count, 0);
+
+	auto refit = [this](Entity e) {
+		auto &mc = registry_.GetComponent<ModelComponent>(e);
+		object_tree_.Update(e, TransformAABB(GetModel_(mc).GetBounds(), object_pushes_[objects_.Find(e)].model));
+	};
+
+	if (objects_.revision != objects_revision_)
+	{
+		std::vector<Entity> removed;
+		object_tree_.Each([&](Entity e) {
+			if (!objects_.Contains(e))
+				removed.push_back(e);
+		});
+		for (Entity e : removed)
+			object_tree_.Remove(e);
+
+		for (Entity e : objects_)
+			if (!object_tree_.Contains(e))
+				refit(e);
+		objects_revision_ = objects_.revision;
+	}
+
+	// Only moved objects are refit, the ones moving within their enlarged
+	// leaf leave the tree unchanged
+	uint32_t since = objects_version_;
+	objects_version_ = registry_.Tick();
+
+	registry_.Each<Changed<TransformComponent>>(objects_, since, [&](Entity e, auto&) { refit(e); });
+	registry_.Each<Changed<ModelComponent>>(objects_, since, [&](Entity e, auto&) { refit(e); });
+
+	if (hierarchy_.revision != hierarchy_revision_)
+	{
+		hierarchy_.EachUpdated([&](Entity e) {
+			if (objects_.Contains(e))
+				refit(e);
+		});
+		hierarchy_revision_ = hierarchy_.revision;
+	}
+
+#ifndef NDEBUG
+	// Transforms written without ModifyComponent are not seen above
+	for (size_t i = 0; i < count; ++i)
+	{
+		Entity e = objects_.entities[i];
+		auto &mc = registry_.GetComponent<ModelComponent>(e);
+		AABB box = TransformAABB(GetModel_(mc).GetBounds(), object_pushes_[i].model);
+		AABB const& leaf = object_tree_.GetBounds(e);
+		for (unsigned a = 0; a < 3; ++a)
+		{
+			if (box.min[a] >= leaf.min[a] && box.max[a] <= leaf.max[a])
+				continue;
+
+			WIL_LOGWARN("Object {} moved without ModifyComponent<TransformComponent>, its culling bounds are stale", e);
+			object_tree_.Update(e, box);
+			break;
+		}
 	}
+#endif
+
+	frustum_ = Frustum::FromMatrix(view_proj);
+	object_tree_.Query(frustum_, [this](Entity e) { object_visible_[objects_.Find(e)] = 1; });
+}
+
+Model &RenderSystem::GetModel_(ModelComponent &mc)
+{
+	if (auto it = models_.find(mc.path); it != models_.end())
+		return it->second;
+
+	constexpr auto f = [](void *data, Fvec3 pos, Fvec2 texcoord, Fvec3 normal) {
+		ObjectVertex v;
+		v.pos = pos;
+		v.texcoord = texcoord;
+		v.normal = normal;
+		std::memcpy(data, &v, sizeof(ObjectVertex));
+	};
+
+	auto &m = models_.emplace(mc.path, Model(device_, mc.path, sizeof(ObjectVertex), f)).first->second;
+	auto start_index = mc.texture_index = object_1_sets.size();
+	object_1_sets.resize(start_index + m.GetTextureCount());
+	object_pool_->AllocateSets(1, object_1_sets.data() + start_index, m.GetTextureCount());
+	for (uint32_t i = 0; i < m.GetTextureCount(); ++i)
+		object_1_sets[start_index + i].BindTexture(0, m.GetTextures()[i]);
+	return m;
+}
+
+Fvec3 RenderSystem::GetWorldPosition_(Entity entity, TransformComponent const& tc) const
+{
+	return hierarchy_.Contains(entity) ? hierarchy_.GetWorldPosition(entity) : tc.position;
+}
+
+void RenderSystem::UploadLights_(StorageBuffer &storage)
+{
+	// The light arrays are mostly empty, only the lights in use and the
+	// counts are copied
+	constexpr size_t points = offsetof(ObjectStorage_0_1, points);
+	constexpr size_t spots = offsetof(ObjectStorage_0_1, spots);
+	constexpr size_t counts = offsetof(ObjectStorage_0_1, pl_count);
+
+	storage.Update(0, points + lights_.pl_count * sizeof(ObjectPointLight), &lights_);
+	storage.Update(spots, lights_.sl_count * sizeof(ObjectSpotLight), lights_.spots);
+	storage.Update(counts, sizeof(ObjectStorage_0_1) - counts, &lights_.pl_count);
+	storage.Flush();
 }
 
 void RenderSystem::Render(CommandBuffer &cb, FrameData &frame)
@@ -169,11 +363,35 @@ void RenderSystem::Render(CommandBuffer &cb, FrameData &frame)
 	Fmat4 proj = PerspectiveProjection(90.f*3.14f/180.f, 16.f/9, .1f, 100.f);
 	Fmat4 cam = LookAtView(camera_.position, camera_ori);
 
+	frame_uniforms_.BeginFrame(frame.index);
+
 	ObjectUniform_0_0 obj00 = { cam, proj, camera_.position };
-	object_0_0_uniforms[frame.index].Update(&obj00);
+	uint32_t obj00_offset = frame_uniforms_.Push(obj00).offset;
 
 	LightUniform_0_0 light00 = { cam, proj };
-	light_0_0_uniforms[frame.index].Update(&light00);
+	uint32_t light00_offset = frame_uniforms_.Push(light00).offset;
+	frame_uniforms_.Flush();
+
+	hierarchy_.Update();
+
+	// Lights storage is shared by all frames, each frame in flight uploads
+	// it again only after it changed
+
+	if (UpdateLights_())
+		std::fill(lights_uploaded_.begin(), lights_uploaded_.end(), false);
+
+	if (!lights_uploaded_[frame.index])
+	{
+		UploadLights_(object_0_1_storages[frame.index]);
+		lights_uploaded_[frame.index] = true;
+	}
+
+	ComposeObjectModels_();
+	CullObjects_(proj * cam);
+
+	// Uploads landed since the last frame are observed once here, the draw
+	// loop only looks them up
+	device_.GetStagingRing().Retire();
 
 	Fvec3 light_pos = {2 * std::cos(frame.app_time), -1.f, 2 * std::sin(frame.app_time)};
 	Fvec3 light_color = {1.f, (std::sin(frame.app_time * 0.7f) + 0.5f) / 2, 0.7f};
@@ -184,99 +402,74 @@ void RenderSystem::Render(CommandBuffer &cb, FrameData &frame)
 		cmd.SetViewport({0, 0}, size);
 		cmd.SetScissor({0, 0}, size);
 
-		ObjectStorage_0_1 obj01;
-		obj01.pl_count = 0, obj01.sl_count = 0;
-
-		obj01.directional.dir = Fvec3(0, 1, 0);
-		obj01.directional.color = Fvec3(1.f);
-
 		cmd.BindPipeline(*light_pipeline_);
 
 		wil::DescriptorSet lsets[] = { light_0_sets[frame.index] };
-		cmd.BindDescriptorSets(*light_pipeline_, 0, lsets, 1);
+		cmd.BindDescriptorSets(*light_pipeline_, 0, lsets, 1, &light00_offset, 1);
 
-		for (Entity e : point_lights_.set)
+		for (Entity e : point_lights_)
 		{
 			auto [tc, lc] = registry_.GetComponents<TransformComponent,PointLightComponent>(e);
 
 			LightPushConstant push;
-			push.model = wil::TranslateModel(tc.position);
+			push.model = wil::TranslateModel(GetWorldPosition_(e, tc));
 			push.light_color = lc.color;
 
 			cmd.PushConstant(*light_pipeline_, &push);
 			cmd.BindVertexBuffer(cube_vbo);
 			cmd.BindIndexBuffer(cube_ibo);
 			cmd.DrawIndexed(36, 1);
-
-			obj01.points[obj01.pl_count++] = ObjectPointLight {
-				.pos = tc.position,
-				.color = lc.color,
-				.linear = lc.linear,
-				.quadratic = lc.quadratic,
-			};
 		}
 
-		for (Entity e : spot_lights_.set)
+		for (Entity e : spot_lights_)
 		{
 			auto [tc, lc] = registry_.GetComponents<TransformComponent,SpotLightComponent>(e);
 
 			LightPushConstant push;
-			push.model = wil::TranslateModel(tc.position);
+			push.model = wil::TranslateModel(GetWorldPosition_(e, tc));
 			push.light_color = lc.color;
 
 			cmd.PushConstant(*light_pipeline_, &push);
 			cmd.BindVertexBuffer(cube_vbo);
 			cmd.BindIndexBuffer(cube_ibo);
 			cmd.DrawIndexed(36, 1);
-
-			obj01.spots[obj01.sl_count++] = ObjectSpotLight {
-				.pos = tc.position,
-				.dir = lc.dir,
-				.color = lc.color,
-				.cutoff = lc.cutoff,
-				.linear = lc.linear,
-				.quadratic = lc.quadratic,
-			};
 		}
 
-		object_0_1_storages[frame.index].Update(&obj01);
-
 		cmd.BindPipeline(*object_pipeline_);
 
-		for (Entity e : objects_.set)
+		StagingRing &ring = device_.GetStagingRing();
+		for (size_t i = 0; i < objects_.size(); ++i)
 		{
-			auto [tc, mc] = registry_.GetComponents<TransformComponent, ModelComponent>(e);
+			if (!object_visible_[i])
+				continue;
 
-			ObjectPushConstant push;
-			push.model = TranslateModel(tc.position) * ScaleModel(tc.size);
-			cmd.PushConstant(*object_pipeline_, &push);
+			auto &mc = registry_.GetComponent<ModelComponent>(objects_.entities[i]);
+			auto &push = object_pushes_[i];
 
-			if (!models_.count(mc.path))
+			// Models streamed in are drawn once their upload landed, the
+			// first frame using them acquires them on the GPU
+			Model &m = GetModel_(mc);
+			if (!m.IsAcquired())
 			{
-				constexpr auto f = [](void *data, Fvec3 pos, Fvec2 texcoord, Fvec3 normal) {
-					ObjectVertex v;
-					v.pos = pos;
-					v.texcoord = texcoord;
-					v.normal = normal;
-					std::memcpy(data, &v, sizeof(ObjectVertex));
-				};
-				models_.emplace(mc.path, Model(device_, mc.path, sizeof(ObjectVertex), f));
-				auto &m = models_.at(mc.path);
-				auto start_index = mc.texture_index = object_1_sets.size();
-				object_1_sets.resize(start_index + m.GetTextureCount());
-				object_pool_->AllocateSets(1, object_1_sets.data() + start_index, m.GetTextureCount());
-				for (uint32_t i = 0; i < m.GetTextureCount(); ++i)
-					object_1_sets[start_index + i].BindTexture(0, m.GetTextures()[i]);
+				if (!ring.IsComplete(m.GetUploadToken()))
+					continue;
+				ring.Acquire(m.GetUploadToken());
+				m.SetAcquired();
 			}
 
-			Model &m = models_.at(mc.path);
+			cmd.PushConstant(*object_pipeline_, &push);
+
+			bool test_meshes = m.GetMeshes().size() > 1;
 
-			for (int i = 0; i < m.GetMeshes().size(); ++i)
+			for (size_t j = 0; j < m.GetMeshes().size(); ++j)
 			{
-				const wil::Mesh &mesh = m.GetMeshes()[i];
+				const wil::Mesh &mesh = m.GetMeshes()[j];
+				if (test_meshes && !frustum_.Intersects(TransformAABB(mesh.bounds, push.model)))
+					continue;
+
 				wil::DescriptorSet sets[] = { object_0_sets[frame.index], object_1_sets[mesh.material_index + mc.texture_index] };
 
-				cmd.BindDescriptorSets(*object_pipeline_, 0, sets, 2);
+				cmd.BindDescriptorSets(*object_pipeline_, 0, sets, 2, &obj00_offset, 1);
 				cmd.BindVertexBuffer(mesh.vertex_buffer);
 
 				if (mesh.index_buffer) {
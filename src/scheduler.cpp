@@ -0,0 +1,58 @@
+#include <wil/scheduler.hpp>
+
+namespace wil {
+
+bool SystemScheduler::Conflicts(const System &a, const System &b)
+{
+	return (a.GetWrites() & (b.GetReads() | b.GetWrites())).any()
+		|| (b.GetWrites() & a.GetReads()).any();
+}
+
+void SystemScheduler::Run(const std::vector<System*> &systems, float elapsed)
+{
+	size_t count = systems.size();
+	if (!count)
+		return;
+
+	// Dependency graph, an edge i -> j for every conflicting pair i < j
+	auto deps = std::make_unique<std::atomic<uint32_t>[]>(count);
+	std::vector<std::vector<uint32_t>> next(count);
+	std::vector<uint32_t> roots;
+
+	for (uint32_t j = 0; j < count; ++j)
+	{
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < j; ++i)
+		{
+			if (Conflicts(*systems[i], *systems[j])) {
+				next[i].push_back(j);
+				++n;
+			}
+		}
+		deps[j] = n;
+		if (!n)
+			roots.push_back(j);
+	}
+
+	std::atomic<size_t> remaining = count;
+
+	std::function<void(uint32_t)> launch = [&](uint32_t i)
+	{
+		pool_.Submit([&, i]
+		{
+			systems[i]->Update(elapsed);
+			for (uint32_t j : next[i])
+				if (--deps[j] == 0)
+					launch(j);
+			--remaining;
+		});
+	};
+
+	// Roots are collected up front, deps is modified as soon as a job runs
+	for (uint32_t i : roots)
+		launch(i);
+
+	pool_.WaitFor(remaining);
+}
+
+}
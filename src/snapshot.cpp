@@ -0,0 +1,59 @@
+#include <wil/snapshot.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define WIL_SNAPSHOT_MMAP
+#endif
+
+namespace wil {
+
+MappedFile::MappedFile(const std::string &path)
+{
+#ifdef WIL_SNAPSHOT_MMAP
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			madvise(data, st.st_size, MADV_SEQUENTIAL);
+			data_ = static_cast<const std::byte*>(data);
+			size_ = st.st_size;
+			mapped_ = true;
+		}
+	}
+
+	close(fd);
+	if (mapped_)
+		return;
+#endif
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return;
+
+	buffer_.resize(file.tellg());
+	file.seekg(0);
+	if (file.read(reinterpret_cast<char*>(buffer_.data()), buffer_.size()) && !buffer_.empty())
+	{
+		data_ = buffer_.data();
+		size_ = buffer_.size();
+	}
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef WIL_SNAPSHOT_MMAP
+	if (mapped_)
+		munmap(const_cast<std::byte*>(data_), size_);
+#endif
+}
+
+}
@@ -1,4 +1,9 @@
 #include <wil/transform.hpp>
+#include <wil/jobs.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 namespace wil {
 
@@ -7,25 +12,6 @@ Fmat4 TranslateModel(Fvec2 position)
 	return TranslateModel(Fvec3(position.x, position.y, 0.0f));
 }
 
-Fmat4 TranslateModel(Fvec3 position)
-{
-#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
-	return {
-		Fvec4(1, 0, 0, position.x),
-		Fvec4(0, 1, 0, position.y),
-		Fvec4(0, 0, 1, position.z),
-		Fvec4(0, 0, 0, 1),
-	};
-#else
-	return {
-		Fvec4(1, 0, 0, 0),
-		Fvec4(0, 1, 0, 0),
-		Fvec4(0, 0, 1, 0),
-		position & 1
-	};
-#endif
-}
-
 Fmat4 RotateModel(float rad, Fvec3 axis)
 {
 	if (rad == 0)
@@ -58,16 +44,6 @@ Fmat4 ScaleModel(Fvec2 scale)
 	return ScaleModel(Fvec3(scale.x, scale.y, 1.0f));
 }
 
-Fmat4 ScaleModel(Fvec3 scale)
-{
-	return {
-		Fvec4(scale.x, 0, 0, 0),
-		Fvec4(0, scale.y, 0, 0),
-		Fvec4(0, 0, scale.z, 0),
-		Fvec4(0, 0, 0, 1)
-	};
-}
-
 Fmat4 LookAtView(Fvec3 position, Fvec3 orientation, Fvec3 up)
 {
 	Fmat4 res(1.0f);
@@ -124,4 +100,146 @@ Fmat4 PerspectiveProjection(float fovy, float aspect, float near, float far)
 	return res;
 }
 
+// Model matrices are composed from their first 3 rows, element 4 * i + j
+// being at row i and column j. The last row is always (0, 0, 0, 1).
+static void StoreModel_(const float e[12], std::byte *dst)
+{
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+	const float m[16] = {
+		e[0], e[1], e[2], e[3],
+		e[4], e[5], e[6], e[7],
+		e[8], e[9], e[10], e[11],
+		0, 0, 0, 1,
+	};
+#else
+	const float m[16] = {
+		e[0], e[4], e[8], 0,
+		e[1], e[5], e[9], 0,
+		e[2], e[6], e[10], 0,
+		e[3], e[7], e[11], 1,
+	};
+#endif
+	std::memcpy(dst, m, sizeof(m));
+}
+
+static void ComposeModel_(TransformBatch const& b, size_t i, std::byte *dst)
+{
+	float x = 0, y = 0, z = 0, w = 1;
+	if (b.qx)
+		x = b.qx[i], y = b.qy[i], z = b.qz[i], w = b.qw[i];
+
+	const float e[12] = {
+		(1 - 2 * (y * y + z * z)) * b.sx[i], 2 * (x * y - w * z) * b.sy[i], 2 * (x * z + w * y) * b.sz[i], b.px[i],
+		2 * (x * y + w * z) * b.sx[i], (1 - 2 * (x * x + z * z)) * b.sy[i], 2 * (y * z - w * x) * b.sz[i], b.py[i],
+		2 * (x * z - w * y) * b.sx[i], 2 * (y * z + w * x) * b.sy[i], (1 - 2 * (x * x + y * y)) * b.sz[i], b.pz[i],
+	};
+	StoreModel_(e, dst);
+}
+
+#ifdef WIL_SIMD_SSE
+
+// Write 4 matrices from registers holding one element of each of them.
+static void StoreModels_(const __m128 e[12], std::byte *dst, size_t stride)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+
+#ifdef WIL_FORCE_MATRIX_ROW_MAJOR
+	__m128 vecs[4][4] = {
+		{ e[0], e[1], e[2], e[3] },
+		{ e[4], e[5], e[6], e[7] },
+		{ e[8], e[9], e[10], e[11] },
+		{ zero, zero, zero, one },
+	};
+#else
+	__m128 vecs[4][4] = {
+		{ e[0], e[4], e[8], zero },
+		{ e[1], e[5], e[9], zero },
+		{ e[2], e[6], e[10], zero },
+		{ e[3], e[7], e[11], one },
+	};
+#endif
+
+	// After the transpose vecs[v][k] is vector v of matrix k
+	for (unsigned v = 0; v < 4; ++v)
+	{
+		_MM_TRANSPOSE4_PS(vecs[v][0], vecs[v][1], vecs[v][2], vecs[v][3]);
+		for (unsigned k = 0; k < 4; ++k)
+			_mm_storeu_ps(reinterpret_cast<float*>(dst + k * stride) + v * 4, vecs[v][k]);
+	}
+}
+
+static void ComposeModels4_(TransformBatch const& b, size_t i, std::byte *dst, size_t stride)
+{
+	__m128 x = _mm_setzero_ps(), y = x, z = x, w = _mm_set1_ps(1.f);
+	if (b.qx)
+	{
+		x = _mm_loadu_ps(b.qx + i);
+		y = _mm_loadu_ps(b.qy + i);
+		z = _mm_loadu_ps(b.qz + i);
+		w = _mm_loadu_ps(b.qw + i);
+	}
+
+	__m128 sx = _mm_loadu_ps(b.sx + i), sy = _mm_loadu_ps(b.sy + i), sz = _mm_loadu_ps(b.sz + i);
+	__m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f);
+
+	__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+	__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+	__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+	auto diagonal = [&](__m128 a, __m128 b, __m128 s) {
+		return _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(a, b))), s);
+	};
+	auto sum = [&](__m128 a, __m128 b, __m128 s) { return _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(a, b)), s); };
+	auto diff = [&](__m128 a, __m128 b, __m128 s) { return _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(a, b)), s); };
+
+	const __m128 e[12] = {
+		diagonal(yy, zz, sx), diff(xy, wz, sy), sum(xz, wy, sz), _mm_loadu_ps(b.px + i),
+		sum(xy, wz, sx), diagonal(xx, zz, sy), diff(yz, wx, sz), _mm_loadu_ps(b.py + i),
+		diff(xz, wy, sx), sum(yz, wx, sy), diagonal(xx, yy, sz), _mm_loadu_ps(b.pz + i),
+	};
+	StoreModels_(e, dst, stride);
+}
+
+#endif
+
+// Compose the models of objects [first, last)
+static void ComposeRange_(TransformBatch const& batch, size_t first, size_t last, std::byte *dst, size_t stride)
+{
+	size_t i = first;
+
+#ifdef WIL_SIMD_SSE
+	for (; i + 4 <= last; i += 4)
+		ComposeModels4_(batch, i, dst + i * stride, stride);
+#endif
+
+	for (; i < last; ++i)
+		ComposeModel_(batch, i, dst + i * stride);
+}
+
+void ComposeModels(TransformBatch const& batch, void *dst, size_t stride)
+{
+	ComposeRange_(batch, 0, batch.count, static_cast<std::byte*>(dst), stride);
+}
+
+void ComposeModels(TransformBatch const& batch, void *dst, size_t stride, ThreadPool &pool, size_t grain)
+{
+	grain = std::max<size_t>(grain, 4);
+	size_t ranges = (batch.count + grain - 1) / grain;
+	if (ranges <= 1)
+		return ComposeModels(batch, dst, stride);
+
+	std::atomic<size_t> remaining = ranges;
+	for (size_t r = 0; r < ranges; ++r)
+	{
+		pool.Submit([&, r] {
+			size_t first = r * grain;
+			ComposeRange_(batch, first, std::min(first + grain, batch.count), static_cast<std::byte*>(dst), stride);
+			--remaining;
+		});
+	}
+
+	pool.WaitFor(remaining);
+}
+
 }
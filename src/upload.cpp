@@ -0,0 +1,566 @@
+#include <wil/upload.hpp>
+#include <wil/log.hpp>
+
+#include <algorithm>
+#include <cstring>
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+namespace wil {
+
+// Stages of the graphics queue reading uploaded resources
+constexpr VkPipelineStageFlags UPLOAD_CONSUMER_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+	| VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+constexpr VkAccessFlags UPLOAD_CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+	| VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+static VkCommandPool CreateCommandPool_(VkDevice dev, uint32_t family_index)
+{
+	VkCommandPoolCreateInfo pool_ci{};
+	pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	pool_ci.queueFamilyIndex = family_index;
+
+	VkCommandPool pool;
+	if (vkCreateCommandPool(dev, &pool_ci, nullptr, &pool) != VK_SUCCESS)
+		WIL_LOGFATAL("Unable to create upload command pool");
+	return pool;
+}
+
+static VkImageMemoryBarrier
+ImageBarrier_(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t src_family, uint32_t dst_family)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = old_layout;
+	barrier.newLayout = new_layout;
+	barrier.srcQueueFamilyIndex = src_family;
+	barrier.dstQueueFamilyIndex = dst_family;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	return barrier;
+}
+
+static VkBufferMemoryBarrier
+BufferBarrier_(VkBuffer buffer, uint64_t offset, uint64_t size, uint32_t src_family, uint32_t dst_family)
+{
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = src_family;
+	barrier.dstQueueFamilyIndex = dst_family;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+	return barrier;
+}
+
+StagingRing::StagingRing(Device &device, uint64_t size)
+	: device_(device), size_(size)
+{
+	auto dev = static_cast<VkDevice>(device.GetVkDevicePtr_());
+
+	buffer_ptr_ = device.GetAllocator().CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, allocation_);
+	if (!allocation_.mapped)
+		WIL_LOGFATAL("Unable to create staging ring of {} bytes", size);
+
+	uint32_t transfer_family = device.GetTransferQueue().family_index;
+	uint32_t graphics_family = device.GetGraphicsQueue().family_index;
+	transfer_ownership_ = transfer_family != graphics_family;
+	transfer_pool_ptr_ = CreateCommandPool_(dev, transfer_family);
+	graphics_pool_ptr_ = transfer_ownership_ ? CreateCommandPool_(dev, graphics_family) : nullptr;
+
+	VkSemaphoreTypeCreateInfo type_ci{};
+	type_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_ci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_ci.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphore_ci{};
+	semaphore_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphore_ci.pNext = &type_ci;
+
+	VkSemaphore timeline;
+	if (vkCreateSemaphore(dev, &semaphore_ci, nullptr, &timeline) != VK_SUCCESS)
+		WIL_LOGFATAL("Unable to create upload timeline semaphore");
+	timeline_ptr_ = timeline;
+}
+
+StagingRing::~StagingRing()
+{
+	if (!open_.empty())
+		WIL_LOGWARN("{} upload batches are still recording", open_.size());
+
+	WaitIdle();
+
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+	for (auto fence : free_fences_)
+		vkDestroyFence(dev, static_cast<VkFence>(fence), nullptr);
+	vkDestroySemaphore(dev, static_cast<VkSemaphore>(timeline_ptr_), nullptr);
+	vkDestroyCommandPool(dev, static_cast<VkCommandPool>(transfer_pool_ptr_), nullptr);
+	if (graphics_pool_ptr_)
+		vkDestroyCommandPool(dev, static_cast<VkCommandPool>(graphics_pool_ptr_), nullptr);
+	vkDestroyBuffer(dev, static_cast<VkBuffer>(buffer_ptr_), nullptr);
+	device_.GetAllocator().Free(allocation_);
+}
+
+void StagingRing::Retire()
+{
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(dev, static_cast<VkSemaphore>(timeline_ptr_), &completed);
+	for (auto it = in_flight_.begin(); it != in_flight_.end();)
+	{
+		if (it->second.value <= completed)
+		{
+			Recycle_(it->second);
+			it = in_flight_.erase(it);
+		}
+		else
+			++it;
+	}
+
+	std::erase_if(acquiring_, [&](Acquisition const& acquisition) {
+		auto fence = static_cast<VkFence>(acquisition.fence);
+		if (vkGetFenceStatus(dev, fence) != VK_SUCCESS)
+			return false;
+		vkResetFences(dev, 1, &fence);
+		free_fences_.push_back(acquisition.fence);
+		free_graphics_cbs_.push_back(acquisition.cb);
+		return true;
+	});
+
+	// The tail moves over finished ranges only, a batch still recording or
+	// in flight keeps the space after it too
+	while (!ranges_.empty() && !open_.count(ranges_.front().serial) && !in_flight_.count(ranges_.front().serial))
+	{
+		tail_ = ranges_.front().end;
+		ranges_.pop_front();
+	}
+
+	if (ranges_.empty())
+		tail_ = head_;
+}
+
+void StagingRing::WaitIdle()
+{
+	WaitValue_(timeline_value_);
+
+	if (!acquiring_.empty())
+	{
+		std::vector<VkFence> fences;
+		for (auto const& acquisition : acquiring_)
+			fences.push_back(static_cast<VkFence>(acquisition.fence));
+		vkWaitForFences(static_cast<VkDevice>(device_.GetVkDevicePtr_()),
+				static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+	}
+
+	Retire();
+}
+
+bool StagingRing::IsComplete(UploadToken token) const
+{
+	if (!open_.empty() && *open_.begin() <= token.serial)
+		return false;
+	return in_flight_.empty() || in_flight_.begin()->first > token.serial;
+}
+
+void StagingRing::Wait(UploadToken token)
+{
+	if (open_.count(token.serial))
+		WIL_LOGWARN("Waiting on upload batch {} which is not submitted", token.serial);
+
+	uint64_t value = 0;
+	for (auto it = in_flight_.begin(); it != in_flight_.end() && it->first <= token.serial; ++it)
+		value = std::max(value, it->second.value);
+	WaitValue_(value);
+}
+
+void StagingRing::Acquire(UploadToken token)
+{
+	if (open_.count(token.serial))
+		WIL_LOGWARN("Upload batch {} is used before it is submitted", token.serial);
+
+	auto end = released_.upper_bound(token.serial);
+	if (released_.begin() == end)
+		return;
+
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+	uint32_t src_family = device_.GetTransferQueue().family_index;
+	uint32_t dst_family = device_.GetGraphicsQueue().family_index;
+	auto cb = static_cast<VkCommandBuffer>(BeginCommandBuffer_(graphics_pool_ptr_, free_graphics_cbs_));
+
+	// Acquire half of the ownership transfers released by the copies
+	uint64_t value = 0;
+	std::vector<VkBufferMemoryBarrier> buffer_barriers;
+	std::vector<VkImageMemoryBarrier> image_barriers;
+	for (auto it = released_.begin(); it != end; ++it)
+	{
+		value = std::max(value, it->second.value);
+		for (auto const& resource : it->second.resources)
+		{
+			if (resource.image)
+			{
+				auto &barrier = image_barriers.emplace_back(ImageBarrier_(static_cast<VkImage>(resource.resource),
+							VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, src_family, dst_family));
+				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			}
+			else
+			{
+				auto &barrier = buffer_barriers.emplace_back(BufferBarrier_(static_cast<VkBuffer>(resource.resource),
+							resource.offset, resource.size, src_family, dst_family));
+				barrier.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+			}
+		}
+	}
+	released_.erase(released_.begin(), end);
+
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, UPLOAD_CONSUMER_STAGES, 0, 0, nullptr,
+			static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+			static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+	vkEndCommandBuffer(cb);
+
+	VkFence fence;
+	if (free_fences_.empty())
+	{
+		VkFenceCreateInfo fence_ci{};
+		fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(dev, &fence_ci, nullptr, &fence) != VK_SUCCESS)
+			WIL_LOGFATAL("Unable to create upload fence");
+	}
+	else
+	{
+		fence = static_cast<VkFence>(free_fences_.back());
+		free_fences_.pop_back();
+	}
+
+	// The graphics queue waits for the copies, the host does not
+	VkTimelineSemaphoreSubmitInfo timeline_i{};
+	timeline_i.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_i.waitSemaphoreValueCount = 1;
+	timeline_i.pWaitSemaphoreValues = &value;
+
+	auto timeline = static_cast<VkSemaphore>(timeline_ptr_);
+	VkPipelineStageFlags wait_stage = UPLOAD_CONSUMER_STAGES;
+
+	VkSubmitInfo submit_i{};
+	submit_i.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_i.pNext = &timeline_i;
+	submit_i.waitSemaphoreCount = 1;
+	submit_i.pWaitSemaphores = &timeline;
+	submit_i.pWaitDstStageMask = &wait_stage;
+	submit_i.commandBufferCount = 1;
+	submit_i.pCommandBuffers = &cb;
+
+	if (vkQueueSubmit(static_cast<VkQueue>(device_.GetGraphicsQueue().vkqueue), 1, &submit_i, fence) != VK_SUCCESS)
+	{
+		WIL_LOGERROR("Unable to submit upload acquisition");
+		free_fences_.push_back(fence);
+		free_graphics_cbs_.push_back(cb);
+		return;
+	}
+
+	acquiring_.push_back({ fence, cb });
+}
+
+void StagingRing::WaitValue_(uint64_t value)
+{
+	if (!value)
+		return;
+
+	auto timeline = static_cast<VkSemaphore>(timeline_ptr_);
+
+	VkSemaphoreWaitInfo wait_i{};
+	wait_i.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_i.semaphoreCount = 1;
+	wait_i.pSemaphores = &timeline;
+	wait_i.pValues = &value;
+
+	vkWaitSemaphores(static_cast<VkDevice>(device_.GetVkDevicePtr_()), &wait_i, UINT64_MAX);
+	Retire();
+}
+
+uint64_t StagingRing::Open_()
+{
+	open_.insert(next_serial_);
+	return next_serial_++;
+}
+
+StagingRing::Staging StagingRing::Reserve_(uint64_t serial, uint64_t size, uint64_t alignment)
+{
+	WIL_ASSERT(alignment && !(alignment & (alignment - 1)));
+	if (size > size_)
+		return {};
+
+	Retire();
+	while (true)
+	{
+		uint64_t begin = (head_ + alignment - 1) & ~(alignment - 1);
+
+		// Ranges never wrap around the end of the buffer
+		if (begin % size_ + size > size_)
+			begin = (begin / size_ + 1) * size_;
+
+		if (begin + size - tail_ <= size_)
+		{
+			head_ = begin + size;
+			ranges_.push_back({ head_, serial });
+			uint64_t offset = begin % size_;
+			return { buffer_ptr_, offset, static_cast<char*>(allocation_.mapped) + offset };
+		}
+
+		// Only a submitted batch can be waited on
+		auto front = in_flight_.find(ranges_.empty() ? 0 : ranges_.front().serial);
+		if (front == in_flight_.end())
+			return {};
+		WaitValue_(front->second.value);
+	}
+}
+
+VendorPtr StagingRing::BeginCommandBuffer_(VendorPtr pool, std::vector<VendorPtr> &free_cbs)
+{
+	VkCommandBuffer cb;
+	if (free_cbs.empty())
+	{
+		VkCommandBufferAllocateInfo info{};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = static_cast<VkCommandPool>(pool);
+		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		info.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(static_cast<VkDevice>(device_.GetVkDevicePtr_()), &info, &cb) != VK_SUCCESS)
+			WIL_LOGFATAL("Unable to create upload command buffer");
+	}
+	else
+	{
+		cb = static_cast<VkCommandBuffer>(free_cbs.back());
+		free_cbs.pop_back();
+	}
+
+	VkCommandBufferBeginInfo begin_i{};
+	begin_i.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_i.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(cb, &begin_i);
+
+	return cb;
+}
+
+void StagingRing::Submit_(uint64_t serial, VendorPtr cb_ptr, std::vector<Temporary> temporaries,
+		std::vector<Ownership> released)
+{
+	auto cb = static_cast<VkCommandBuffer>(cb_ptr);
+	vkEndCommandBuffer(cb);
+
+	uint64_t value = timeline_value_ + 1;
+	VkTimelineSemaphoreSubmitInfo timeline_i{};
+	timeline_i.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_i.signalSemaphoreValueCount = 1;
+	timeline_i.pSignalSemaphoreValues = &value;
+
+	auto timeline = static_cast<VkSemaphore>(timeline_ptr_);
+
+	VkSubmitInfo submit_i{};
+	submit_i.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_i.pNext = &timeline_i;
+	submit_i.commandBufferCount = 1;
+	submit_i.pCommandBuffers = &cb;
+	submit_i.signalSemaphoreCount = 1;
+	submit_i.pSignalSemaphores = &timeline;
+
+	open_.erase(serial);
+	Submission submission = { value, cb, std::move(temporaries) };
+	if (vkQueueSubmit(static_cast<VkQueue>(device_.GetTransferQueue().vkqueue), 1, &submit_i, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		// The value is never signaled, the copies are dropped
+		WIL_LOGERROR("Unable to submit upload batch");
+		Recycle_(submission);
+		Retire();
+		return;
+	}
+
+	timeline_value_ = value;
+	in_flight_.emplace(serial, std::move(submission));
+	if (!released.empty())
+		released_.emplace(serial, Release{ value, std::move(released) });
+}
+
+void StagingRing::Recycle_(Submission &submission)
+{
+	auto dev = static_cast<VkDevice>(device_.GetVkDevicePtr_());
+	free_transfer_cbs_.push_back(submission.cb);
+
+	for (auto &temporary : submission.temporaries)
+	{
+		vkDestroyBuffer(dev, static_cast<VkBuffer>(temporary.buffer), nullptr);
+		device_.GetAllocator().Free(temporary.allocation);
+	}
+	submission.temporaries.clear();
+}
+
+UploadBatch::UploadBatch(Device &device)
+	: device_(device), ring_(device.GetStagingRing())
+{
+}
+
+UploadBatch::~UploadBatch()
+{
+	Submit();
+}
+
+StagingRing::Staging UploadBatch::Stage_(const void *src, uint64_t size, uint64_t alignment)
+{
+	if (!cb_ptr_)
+	{
+		serial_ = ring_.Open_();
+		cb_ptr_ = ring_.BeginCommandBuffer_(ring_.transfer_pool_ptr_, ring_.free_transfer_cbs_);
+
+		// Copies must not overwrite buffers read by earlier submissions of
+		// the same queue
+		if (!ring_.transfer_ownership_)
+			vkCmdPipelineBarrier(static_cast<VkCommandBuffer>(cb_ptr_), UPLOAD_CONSUMER_STAGES,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+	}
+
+	StagingRing::Staging staging = ring_.Reserve_(serial_, size, alignment);
+	if (!staging.buffer && staged_)
+	{
+		// The batch fills the ring on its own, submit what it holds so far
+		Submit();
+		return Stage_(src, size, alignment);
+	}
+
+	if (!staging.buffer)
+	{
+		StagingRing::Temporary temporary;
+		temporary.buffer = device_.GetAllocator().CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, temporary.allocation);
+		if (!temporary.allocation.mapped)
+		{
+			WIL_LOGERROR("Unable to stage an upload of {} bytes", size);
+			vkDestroyBuffer(static_cast<VkDevice>(device_.GetVkDevicePtr_()), static_cast<VkBuffer>(temporary.buffer), nullptr);
+			return {};
+		}
+
+		temporaries_.push_back(temporary);
+		staging = { temporary.buffer, 0, temporary.allocation.mapped };
+	}
+	else
+		staged_ = true;
+
+	std::memcpy(staging.mapped, src, size);
+	return staging;
+}
+
+void UploadBatch::CopyToBuffer(VendorPtr buffer_ptr, uint64_t offset, const void *src, uint64_t size)
+{
+	StagingRing::Staging staging = Stage_(src, size, 16);
+	if (!staging.buffer)
+		return;
+
+	auto cb = static_cast<VkCommandBuffer>(cb_ptr_);
+	auto buffer = static_cast<VkBuffer>(buffer_ptr);
+
+	VkBufferCopy copy{};
+	copy.srcOffset = staging.offset;
+	copy.dstOffset = offset;
+	copy.size = size;
+	vkCmdCopyBuffer(cb, static_cast<VkBuffer>(staging.buffer), buffer, 1, &copy);
+
+	if (ring_.transfer_ownership_)
+	{
+		// Release half of the ownership transfer to the graphics queue
+		VkBufferMemoryBarrier barrier = BufferBarrier_(buffer, offset, size,
+				device_.GetTransferQueue().family_index, device_.GetGraphicsQueue().family_index);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, 1, &barrier, 0, nullptr);
+		released_.push_back({ buffer_ptr, offset, size, false });
+	}
+}
+
+void UploadBatch::CopyToImage(VendorPtr image_ptr, uint32_t width, uint32_t height, const void *src, uint64_t size)
+{
+	StagingRing::Staging staging = Stage_(src, size, 16);
+	if (!staging.buffer)
+		return;
+
+	auto cb = static_cast<VkCommandBuffer>(cb_ptr_);
+	auto image = static_cast<VkImage>(image_ptr);
+
+	VkImageMemoryBarrier barrier = ImageBarrier_(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = staging.offset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyBufferToImage(cb, static_cast<VkBuffer>(staging.buffer), image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	if (ring_.transfer_ownership_)
+	{
+		// Release half of the ownership transfer, the layout changes with it
+		barrier = ImageBarrier_(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				device_.GetTransferQueue().family_index, device_.GetGraphicsQueue().family_index);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+		released_.push_back({ image_ptr, 0, 0, true });
+	}
+	else
+	{
+		barrier = ImageBarrier_(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+}
+
+UploadToken UploadBatch::Submit()
+{
+	if (!cb_ptr_)
+		return token_;
+
+	if (!ring_.transfer_ownership_)
+	{
+		// Make the copies visible to the draws submitted after the batch
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+		vkCmdPipelineBarrier(static_cast<VkCommandBuffer>(cb_ptr_), VK_PIPELINE_STAGE_TRANSFER_BIT,
+				UPLOAD_CONSUMER_STAGES, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	ring_.Submit_(serial_, cb_ptr_, std::move(temporaries_), std::move(released_));
+	token_ = { serial_ };
+
+	temporaries_.clear();
+	released_.clear();
+	cb_ptr_ = nullptr;
+	staged_ = false;
+	serial_ = 0;
+	return token_;
+}
+
+void UploadBatch::Wait()
+{
+	ring_.Wait(token_);
+}
+
+}
@@ -0,0 +1,53 @@
+#include <wil/log.hpp>
+#include <wil/memory.hpp>
+
+#include <vector>
+
+using namespace wil;
+
+int main()
+{
+	FreeListAllocator ranges(1024);
+
+	// Aligned allocations leave their padding free
+	uint64_t a = ranges.Allocate(100);
+	uint64_t b = ranges.Allocate(64, 256);
+	uint64_t c = ranges.Allocate(200, 16);
+	WIL_ASSERT(a == 0 && b == 256 && c % 16 == 0);
+	WIL_ASSERT(ranges.GetUsed() == 364 && ranges.GetAllocationCount() == 3);
+	WIL_ASSERT(ranges.Allocate(2048) == FreeListAllocator::INVALID_OFFSET);
+
+	// Best fit takes the padding in front of b instead of the tail
+	uint64_t d = ranges.Allocate(100);
+	WIL_ASSERT(d >= 100 && d + 100 <= 256);
+
+	// Freeing everything merges the ranges back into one
+	for (uint64_t offset : { b, d, a, c })
+		ranges.Free(offset);
+	WIL_ASSERT(ranges.GetUsed() == 0 && ranges.GetFreeRangeCount() == 1);
+	WIL_ASSERT(ranges.GetLargestFreeRange() == 1024);
+
+	// Freeing every other slot fragments the range
+	std::vector<uint64_t> slots;
+	for (uint64_t offset; (offset = ranges.Allocate(32)) != FreeListAllocator::INVALID_OFFSET;)
+		slots.push_back(offset);
+	WIL_ASSERT(slots.size() == 32);
+	for (size_t i = 0; i < slots.size(); i += 2)
+		ranges.Free(slots[i]);
+	WIL_ASSERT(ranges.GetFreeRangeCount() == 16 && ranges.GetLargestFreeRange() == 32);
+	WIL_ASSERT(ranges.Allocate(64) == FreeListAllocator::INVALID_OFFSET);
+
+	MemoryStats stats;
+	stats.reserved_bytes = ranges.GetSize();
+	stats.used_bytes = ranges.GetUsed();
+	stats.largest_free_range = ranges.GetLargestFreeRange();
+	WIL_LOGINFO("Fragmentation {}", stats.GetFragmentation());
+	WIL_ASSERT(stats.GetFragmentation() > 0.9f);
+
+	for (size_t i = 1; i < slots.size(); i += 2)
+		ranges.Free(slots[i]);
+	WIL_ASSERT(ranges.GetFreeRangeCount() == 1 && ranges.Allocate(1024) == 0);
+
+	WIL_LOGINFO("Free list allocator passed");
+	return 0;
+}
@@ -0,0 +1,36 @@
+#include <wil/log.hpp>
+#include <wil/memory.hpp>
+
+using namespace wil;
+
+int main()
+{
+	DirtyRanges dirty(4);
+	WIL_ASSERT(dirty.IsEmpty());
+
+	// Empty writes are ignored, disjoint ones are kept sorted
+	dirty.Add(64, 0);
+	dirty.Add(300, 20);
+	dirty.Add(100, 50);
+	WIL_ASSERT(dirty.GetRanges().size() == 2);
+	WIL_ASSERT(dirty.GetRanges()[0].offset == 100 && dirty.GetRanges()[1].offset == 300);
+
+	// Touching and overlapping writes merge, also across several ranges
+	dirty.Add(150, 10);
+	WIL_ASSERT(dirty.GetRanges().size() == 2 && dirty.GetRanges()[0].size == 60);
+	dirty.Add(120, 190);
+	WIL_ASSERT(dirty.GetRanges().size() == 1);
+	WIL_ASSERT(dirty.GetRanges()[0].offset == 100 && dirty.GetRanges()[0].size == 220);
+
+	// Past the maximum count the closest ranges merge
+	dirty.Clear();
+	for (uint64_t offset : { 0, 100, 200, 300 })
+		dirty.Add(offset, 10);
+	dirty.Add(315, 10);
+	WIL_ASSERT(dirty.GetRanges().size() == 4);
+	WIL_ASSERT(dirty.GetRanges()[3].offset == 300 && dirty.GetRanges()[3].size == 25);
+	WIL_LOGINFO("Dirty bytes {}", dirty.GetBytes());
+	WIL_ASSERT(dirty.GetBytes() == 55);
+
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include <wil/log.hpp>
+#include <wil/device.hpp>
+#include <wil/memory.hpp>
+
+#include <GLFW/glfw3.h>
+#include <vector>
+
+using namespace wil;
+
+// Exit code ctest reports as skipped, when no Vulkan device is available
+constexpr int SKIPPED = 77;
+
+static void TestAllocator(Device &device)
+{
+	using enum MemoryAllocator::Kind;
+
+	constexpr uint64_t BLOCK_SIZE = 1 << 20;
+	MemoryAllocator allocator(device, BLOCK_SIZE);
+	uint32_t host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+	// Small allocations share a mapped block
+	MemoryAllocation a = allocator.Allocate(1000, 256, ~0u, host, KIND_BUFFER);
+	MemoryAllocation b = allocator.Allocate(1000, 256, ~0u, host, KIND_BUFFER);
+	WIL_ASSERT(a.memory && a.mapped && a.memory == b.memory && a.offset != b.offset);
+
+	MemoryStats stats = allocator.GetStats();
+	WIL_ASSERT(stats.block_count == 1 && stats.allocation_count == 2);
+	WIL_ASSERT(stats.reserved_bytes == BLOCK_SIZE && stats.used_bytes >= 2000);
+
+	// Freed ranges are reused before any new block
+	allocator.Free(a);
+	a = allocator.Allocate(1000, 256, ~0u, host, KIND_BUFFER);
+	WIL_ASSERT(a.memory == b.memory && allocator.GetStats().block_count == 1);
+
+	// Resources over half a block get dedicated memory, released on free
+	MemoryAllocation dedicated = allocator.Allocate(BLOCK_SIZE / 2 + 1, 256, ~0u, host, KIND_BUFFER);
+	WIL_ASSERT(dedicated.memory && dedicated.memory != b.memory && dedicated.offset == 0);
+	stats = allocator.GetStats();
+	WIL_ASSERT(stats.block_count == 2 && stats.allocation_count == 3 && stats.reserved_bytes == BLOCK_SIZE);
+	allocator.Free(dedicated);
+	WIL_ASSERT(allocator.GetStats().block_count == 1);
+
+	// A full block makes a new one, a single empty block stays alive
+	std::vector<MemoryAllocation> large;
+	for (int i = 0; i < 3; ++i)
+		large.push_back(allocator.Allocate(400 << 10, 256, ~0u, host, KIND_BUFFER));
+	WIL_ASSERT(large[2].memory != b.memory && allocator.GetStats().block_count == 2);
+
+	allocator.Free(large[2]);
+	WIL_ASSERT(allocator.GetStats().block_count == 2);
+
+	for (auto const& allocation : { a, b, large[0], large[1] })
+		allocator.Free(allocation);
+	stats = allocator.GetStats();
+	WIL_ASSERT(stats.block_count == 1 && stats.allocation_count == 0 && stats.used_bytes == 0);
+
+	// Buffers and images never share a block
+	MemoryAllocation buffer = allocator.Allocate(1000, 256, ~0u, 0, KIND_BUFFER);
+	MemoryAllocation image = allocator.Allocate(1000, 256, ~0u, 0, KIND_IMAGE);
+	WIL_ASSERT(buffer.memory && image.memory && buffer.memory != image.memory);
+	allocator.Free(buffer);
+	allocator.Free(image);
+
+	WIL_LOGINFO("{} blocks left, {} bytes reserved", allocator.GetStats().block_count, allocator.GetStats().reserved_bytes);
+}
+
+int main()
+{
+	if (!glfwInit() || !glfwVulkanSupported())
+	{
+		WIL_LOGWARN("No Vulkan support, test skipped");
+		return SKIPPED;
+	}
+
+	VkApplicationInfo app_i{};
+	app_i.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	app_i.apiVersion = VK_API_VERSION_1_3;
+
+	uint32_t extension_count;
+	const char **extensions = glfwGetRequiredInstanceExtensions(&extension_count);
+
+	VkInstanceCreateInfo inst_ci{};
+	inst_ci.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	inst_ci.pApplicationInfo = &app_i;
+	inst_ci.enabledExtensionCount = extension_count;
+	inst_ci.ppEnabledExtensionNames = extensions;
+
+	VkInstance instance;
+	if (vkCreateInstance(&inst_ci, nullptr, &instance) != VK_SUCCESS)
+	{
+		WIL_LOGWARN("Unable to initialize Vulkan 1.3, test skipped");
+		glfwTerminate();
+		return SKIPPED;
+	}
+
+	uint32_t device_count = 0;
+	vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
+
+	// The device needs a surface to present to
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow *window = device_count ? glfwCreateWindow(64, 64, "", nullptr, nullptr) : nullptr;
+
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	if (!window || glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+	{
+		WIL_LOGWARN("No Vulkan device, test skipped");
+		if (window)
+			glfwDestroyWindow(window);
+		vkDestroyInstance(instance, nullptr);
+		glfwTerminate();
+		return SKIPPED;
+	}
+
+	{
+		Device device(instance, surface, Ivec2(64, 64), false);
+		TestAllocator(device);
+	}
+
+	vkDestroySurfaceKHR(instance, surface, nullptr);
+	glfwDestroyWindow(window);
+	vkDestroyInstance(instance, nullptr);
+	glfwTerminate();
+}
@@ -25,7 +25,7 @@ public:
 
 	void process(Registry &registry)
 	{
-		for (Entity e : view.set)
+		for (Entity e : view)
 		{
 			auto [t, t2] = registry.GetComponents<Test, Test2>(e);
 			t.val *= 2.f;
@@ -48,4 +48,20 @@ int main()
 	registry.RemoveComponents<Test>(e);
 
 	s.process(registry);
+
+	registry.AddComponents(e, Test{3.0f});
+
+	registry.Each<Test, Test2>([](Entity, Test &t, Test2 &t2) {
+		WIL_LOGINFO("{}", t.val + t2.wow.Norm());
+	});
+
+	registry.DestroyEntity(e);
+	WIL_ASSERT(!registry.IsAlive(e));
+
+	auto entities = registry.CreateEntities(100, Test{2.0f}, Test2{Ivec2{1, 0}});
+	WIL_ASSERT(registry.IsAlive(entities[0]) && entities[0] != e);
+	WIL_ASSERT(s.view.size() == 100);
+
+	registry.DestroyEntities(std::span(entities).first(50));
+	WIL_ASSERT(s.view.size() == 50);
 }
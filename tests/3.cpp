@@ -30,8 +30,7 @@ public:
 		wil::TransformComponent tc = {
 			{0, 0, 0},
 			{0.01f, 0.01f, 0.01f},
-			{0, 1, 0},
-			0.f
+			wil::Fquat::Identity()
 		};
 
 		wil::ModelComponent mc = {
@@ -98,7 +97,7 @@ public:
 		}
 
 		Fvec3 light_pos = {5 * cos(frame.app_time), 1.f, 5 * sin(frame.app_time)};
-		registry.GetComponent<wil::TransformComponent>(e4).position = light_pos;
+		registry.ModifyComponent<wil::TransformComponent>(e4).position = light_pos;
 
 		std::vector<wil::CommandBuffer*> cbs;
 		cbs.emplace_back(&cmdbufs[frame.index]);
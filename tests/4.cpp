@@ -0,0 +1,70 @@
+#include <wil/algebra.hpp>
+#include <wil/log.hpp>
+#include <wil/archetype.hpp>
+
+#include <string>
+
+using namespace wil;
+
+struct Position {
+	Fvec3 value;
+};
+
+struct Velocity {
+	Fvec3 value;
+};
+
+struct Name {
+	std::string value;
+};
+
+int main()
+{
+	ArchetypeRegistry registry;
+	std::vector<Entity> entities;
+
+	for (int i = 0; i < 5000; ++i)
+	{
+		Entity e = registry.CreateEntity();
+		registry.AddComponents(e, Position{Fvec3(0.f)}, Velocity{Fvec3(1.f, 0.f, 0.f)});
+		if (i % 2 == 0)
+			registry.AddComponents(e, Name{std::to_string(i)});
+		entities.push_back(e);
+	}
+
+	registry.Each<Position, Velocity>([](Entity, Position &p, Velocity &v) {
+		p.value += v.value;
+	});
+
+	for (int i = 0; i < 5000; i += 3)
+		registry.DestroyEntity(entities[i]);
+
+	for (int i = 1; i < 5000; i += 3)
+		registry.RemoveComponents<Velocity>(entities[i]);
+
+	size_t moving = 0, named = 0;
+	registry.Each<Position, Velocity>([&](Entity, Position &p, Velocity &) {
+		WIL_ASSERT(p.value == Fvec3(1.f, 0.f, 0.f));
+		++moving;
+	});
+	registry.Each<Name>([&](Entity e, Name &n) {
+		WIL_ASSERT(registry.HasComponents<Position>(e));
+		++named;
+	});
+
+	WIL_ASSERT(registry.GetComponent<Name>(entities[2]).value == "2");
+	WIL_ASSERT(!registry.HasComponents<Velocity>(entities[1]));
+
+	// Adding a component the entity has replaces it, alone or along a new
+	// one, names are long enough to own heap memory
+	std::string long_name(100, 'a');
+	registry.AddComponents(entities[2], Name{long_name});
+	registry.AddComponents(entities[2], Name{long_name + "b"});
+	WIL_ASSERT(registry.GetComponent<Name>(entities[2]).value == long_name + "b");
+	registry.AddComponents(entities[4], Name{long_name});
+	registry.AddComponents(entities[4], Name{long_name + "c"}, Velocity{Fvec3(2.f)});
+	WIL_ASSERT(registry.GetComponent<Name>(entities[4]).value == long_name + "c");
+	WIL_ASSERT(registry.GetComponent<Velocity>(entities[4]).value == Fvec3(2.f));
+
+	WIL_LOGINFO("{} entities, {} moving, {} named", registry.GetEntitiesCount(), moving, named);
+}
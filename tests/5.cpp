@@ -0,0 +1,134 @@
+#include <wil/log.hpp>
+#include <wil/ecs.hpp>
+#include <wil/scheduler.hpp>
+
+using namespace wil;
+
+struct Position {
+	Fvec3 value;
+};
+
+struct Velocity {
+	Fvec3 value;
+};
+
+struct Health {
+	float value;
+};
+
+class MoveSystem : public System
+{
+public:
+
+	EntityView view;
+	Registry &registry;
+
+	MoveSystem(Registry &registry) : System(registry), registry(registry) {
+		registry.RegisterEntityView<Position, Velocity>(view);
+		Reads<Velocity>(registry);
+		Writes<Position>(registry);
+	}
+
+	void Update(float elapsed) override
+	{
+		for (Entity e : view)
+		{
+			auto [p, v] = registry.GetComponents<Position, Velocity>(e);
+			p.value += elapsed * v.value;
+		}
+	}
+};
+
+class AccelerateSystem : public System
+{
+public:
+
+	EntityView view;
+	Registry &registry;
+
+	AccelerateSystem(Registry &registry) : System(registry), registry(registry) {
+		registry.RegisterEntityView<Velocity>(view);
+		Writes<Velocity>(registry);
+	}
+
+	void Update(float elapsed) override
+	{
+		for (Entity e : view)
+			registry.GetComponent<Velocity>(e).value += Fvec3(elapsed, 0.f, 0.f);
+	}
+};
+
+class RegenerateSystem : public System
+{
+public:
+
+	EntityView view;
+	Registry &registry;
+
+	RegenerateSystem(Registry &registry) : System(registry), registry(registry) {
+		registry.RegisterEntityView<Health>(view);
+		Writes<Health>(registry);
+	}
+
+	void Update(float elapsed) override
+	{
+		for (Entity e : view)
+			registry.GetComponent<Health>(e).value += elapsed;
+	}
+};
+
+int main()
+{
+	Registry registry;
+	registry.RegisterSystem<MoveSystem>();
+	registry.RegisterSystem<AccelerateSystem>();
+	registry.RegisterSystem<RegenerateSystem>();
+
+	Entity e = registry.CreateEntity();
+	registry.AddComponents(e, Position{Fvec3(0.f)}, Velocity{Fvec3(0.f)}, Health{0.f});
+
+	WIL_ASSERT(SystemScheduler::Conflicts(registry.GetSystem<MoveSystem>(), registry.GetSystem<AccelerateSystem>()));
+	WIL_ASSERT(!SystemScheduler::Conflicts(registry.GetSystem<MoveSystem>(), registry.GetSystem<RegenerateSystem>()));
+
+	ThreadPool pool(4);
+	SystemScheduler scheduler(pool);
+
+	for (int i = 0; i < 4; ++i)
+		scheduler.Run(registry.GetSystems(), 1.f);
+
+	// Move always runs before Accelerate: 0 + 1 + 2 + 3
+	auto [p, h] = registry.GetComponents<Position, Health>(e);
+	WIL_ASSERT(p.value.x == 6.f);
+	WIL_ASSERT(h.value == 4.f);
+
+	WIL_LOGINFO("Position {}, health {}", p.value, h.value);
+
+	// Spawn from worker threads through a command buffer
+	RegistryCommandBuffer commands(registry);
+	std::atomic<size_t> remaining = 8;
+	for (int i = 0; i < 8; ++i)
+		pool.Submit([&] {
+			Entity spawned = commands.CreateEntity();
+			commands.AddComponents(spawned, Position{Fvec3(0.f)}, Velocity{Fvec3(1.f)});
+			--remaining;
+		});
+	pool.WaitFor(remaining);
+
+	commands.DestroyEntity(e);
+	registry.Playback(commands);
+
+	WIL_ASSERT(registry.GetSystem<MoveSystem>().view.size() == 8);
+	WIL_ASSERT(registry.GetSystem<RegenerateSystem>().view.size() == 0);
+	WIL_ASSERT(commands.IsEmpty());
+
+	// Entities reserved by a buffer dropped without playback are reused
+	Entity dropped;
+	{
+		RegistryCommandBuffer discarded(registry);
+		dropped = discarded.CreateEntity();
+		discarded.AddComponents(dropped, Position{Fvec3(0.f)});
+	}
+	Entity reused = registry.CreateEntity();
+	WIL_ASSERT(EntityIndex(reused) == EntityIndex(dropped) && reused != dropped);
+	WIL_ASSERT(!registry.IsAlive(dropped));
+}
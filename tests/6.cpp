@@ -0,0 +1,115 @@
+#include <wil/log.hpp>
+#include <wil/snapshot.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace wil;
+
+struct Position {
+	Fvec3 value;
+};
+
+struct Velocity {
+	Fvec3 value;
+};
+
+struct Name {
+	std::string value;
+};
+
+int main()
+{
+	std::vector<Entity> entities;
+
+	{
+		Registry registry;
+		entities = registry.CreateEntities(1000, Position{Fvec3(1.f, 2.f, 3.f)});
+
+		for (size_t i = 0; i < entities.size(); i += 2)
+			registry.AddComponents(entities[i], Velocity{Fvec3(float(i))}, Name{"moving"});
+
+		registry.DestroyEntity(entities[1]);
+
+		WIL_ASSERT(SaveSnapshot(registry, "snapshot.bin"));
+	}
+
+	Registry registry;
+	registry.RegisterComponent<Position>();
+	registry.RegisterComponent<Velocity>();
+	registry.RegisterComponent<Name>();
+
+	EntityView moving;
+	registry.RegisterEntityView<Position, Velocity>(moving);
+
+	WIL_ASSERT(LoadSnapshot(registry, "snapshot.bin"));
+
+	WIL_ASSERT(!registry.IsAlive(entities[1]));
+	WIL_ASSERT(registry.IsAlive(entities[2]));
+	WIL_ASSERT(moving.size() == 500);
+	WIL_ASSERT(registry.GetComponent<Velocity>(entities[4]).value.x == 4.f);
+	WIL_ASSERT(registry.GetComponent<Position>(entities[999]).value.z == 3.f);
+
+	// Names are not trivially copyable and were not saved
+	WIL_ASSERT(!registry.HasComponents<Name>(entities[0]));
+
+	Entity e = registry.CreateEntity();
+	WIL_ASSERT(EntityIndex(e) == EntityIndex(entities[1]) && e != entities[1]);
+
+	// Sections of a wrong component size, of a count overflowing the file,
+	// holding entities past the saved slots, dead or repeated are rejected
+	std::string bytes;
+	{
+		std::ifstream file("snapshot.bin", std::ios::binary);
+		bytes.assign(std::istreambuf_iterator<char>(file), {});
+	}
+
+	SnapshotHeader header;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	auto padded = [](size_t size) { return (size + 7) / 8 * 8; };
+	size_t refills = padded(sizeof(header)) + padded(header.slots * sizeof(Entity))
+		+ padded(header.slots * sizeof(uint64_t));
+	size_t section = refills + padded(header.refills * sizeof(Entity));
+
+	auto load = [&](std::string const& copy) {
+		std::ofstream("corrupted.bin", std::ios::binary).write(copy.data(), copy.size());
+		return LoadSnapshot(registry, "corrupted.bin");
+	};
+
+	auto load_corrupted = [&](auto &&corrupt) {
+		std::string copy = bytes;
+		SnapshotComponentHeader component;
+		std::memcpy(&component, copy.data() + section, sizeof(component));
+		Entity *first = reinterpret_cast<Entity*>(copy.data() + section + sizeof(component));
+		corrupt(component, first);
+		std::memcpy(copy.data() + section, &component, sizeof(component));
+		return load(copy);
+	};
+
+	WIL_ASSERT(!load_corrupted([](SnapshotComponentHeader &c, Entity *) { c.size = 1; }));
+	WIL_ASSERT(!load_corrupted([](SnapshotComponentHeader &c, Entity *) { c.count = UINT64_MAX / c.size + 2; }));
+	WIL_ASSERT(!load_corrupted([&](SnapshotComponentHeader &, Entity *e) { e[0] = MakeEntity(header.slots, 0); }));
+	WIL_ASSERT(!load_corrupted([&](SnapshotComponentHeader &, Entity *e) { e[1] = entities[1]; }));
+	WIL_ASSERT(!load_corrupted([&](SnapshotComponentHeader &, Entity *e) { e[2] = e[0]; }));
+
+	// So are inconsistent entity tables
+	auto load_inconsistent = [&](auto &&corrupt) {
+		std::string copy = bytes;
+		SnapshotHeader h = header;
+		corrupt(h, reinterpret_cast<Entity*>(copy.data() + padded(sizeof(header))),
+				reinterpret_cast<Entity*>(copy.data() + refills));
+		std::memcpy(copy.data(), &h, sizeof(h));
+		return load(copy);
+	};
+
+	WIL_ASSERT(!load_inconsistent([](SnapshotHeader &h, Entity *, Entity *) { h.next_entity = h.slots + 1; }));
+	WIL_ASSERT(!load_inconsistent([](SnapshotHeader &h, Entity *, Entity *) { ++h.entities_count; }));
+	WIL_ASSERT(!load_inconsistent([](SnapshotHeader &, Entity *handles, Entity *) { handles[3] = handles[2]; }));
+	WIL_ASSERT(!load_inconsistent([](SnapshotHeader &, Entity *handles, Entity *r) { r[0] = handles[2]; }));
+	WIL_ASSERT(load_inconsistent([](SnapshotHeader &, Entity *, Entity *) {}));
+	WIL_ASSERT(registry.GetComponent<Velocity>(entities[4]).value.x == 4.f);
+
+	WIL_LOGINFO("Loaded {} moving entities", moving.size());
+}
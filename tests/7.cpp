@@ -0,0 +1,73 @@
+#include <wil/log.hpp>
+#include <wil/hierarchy.hpp>
+#include <wil/jobs.hpp>
+#include <wil/transform.hpp>
+
+using namespace wil;
+
+bool Near(Fvec3 a, Fvec3 b)
+{
+	return (a - b).Norm() < 1e-4f;
+}
+
+int main()
+{
+	Registry registry;
+	TransformHierarchy hierarchy(registry);
+
+	TransformComponent tc = { {1, 0, 0}, {1, 1, 1}, Fquat::Identity() };
+
+	Entity vehicle = registry.CreateEntity();
+	registry.AddComponents(vehicle, tc);
+
+	Entity turret = registry.CreateEntity();
+	registry.AddComponents(turret, tc, HierarchyComponent{vehicle});
+
+	Entity light = registry.CreateEntity();
+	registry.AddComponents(light, tc, HierarchyComponent{turret});
+
+	auto wheels = registry.CreateEntities(5000, tc, HierarchyComponent{vehicle});
+
+	hierarchy.Update();
+	WIL_ASSERT(hierarchy.size() == 5003 && hierarchy.GetLevelCount() == 3);
+	WIL_ASSERT(Near(hierarchy.GetWorldPosition(light), {3, 0, 0}));
+
+	// Moving the root moves the whole subtree
+	registry.ModifyComponent<TransformComponent>(vehicle).position = {0, 5, 0};
+	hierarchy.Update();
+	WIL_ASSERT(Near(hierarchy.GetWorldPosition(light), {2, 5, 0}));
+	WIL_ASSERT(Near(hierarchy.GetWorldPosition(wheels[42]), {1, 5, 0}));
+
+	registry.ModifyComponent<TransformComponent>(turret).rotation = Fquat::AxisAngle(Radians(90.f), {0, 0, 1});
+	ThreadPool pool(2);
+	hierarchy.Update(pool, 256);
+	WIL_ASSERT(Near(hierarchy.GetWorldPosition(light), {1, 6, 0}));
+	WIL_ASSERT(Near(hierarchy.GetWorldPosition(wheels.back()), {1, 5, 0}));
+
+	// Reparenting and destroying parents restructure the hierarchy
+	registry.ModifyComponent<HierarchyComponent>(light).parent = vehicle;
+	hierarchy.Update();
+	WIL_ASSERT(hierarchy.GetLevelCount() == 2);
+	WIL_ASSERT(Near(hierarchy.GetWorldPosition(light), {1, 5, 0}));
+
+	registry.DestroyEntity(vehicle);
+	hierarchy.Update();
+	WIL_ASSERT(!hierarchy.Contains(vehicle));
+	WIL_ASSERT(Near(hierarchy.GetWorldPosition(turret), {1, 0, 0}));
+
+	// Transforms outside the hierarchy leave it untouched, a parent gaining
+	// its transform joins it
+	Entity anchor = registry.CreateEntity();
+	Entity child = registry.CreateEntity();
+	registry.AddComponents(child, tc, HierarchyComponent{anchor});
+	hierarchy.Update();
+	size_t revision = hierarchy.revision;
+	registry.AddComponents(registry.CreateEntity(), tc);
+	hierarchy.Update();
+	WIL_ASSERT(hierarchy.revision == revision && Near(hierarchy.GetWorldPosition(child), {1, 0, 0}));
+	registry.AddComponents(anchor, tc);
+	hierarchy.Update();
+	WIL_ASSERT(hierarchy.Contains(anchor) && Near(hierarchy.GetWorldPosition(child), {2, 0, 0}));
+
+	WIL_LOGINFO("Hierarchy of {} nodes", hierarchy.size());
+}
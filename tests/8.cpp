@@ -0,0 +1,44 @@
+#include <wil/log.hpp>
+#include <wil/bounds.hpp>
+#include <wil/transform.hpp>
+
+#include <vector>
+
+using namespace wil;
+
+int main()
+{
+	Fmat4 proj = PerspectiveProjection(Radians(90.f), 16.f / 9, .1f, 100.f);
+	Fmat4 view = LookAtView({0.f, 0.f, 0.f}, {0.f, 0.f, 1.f});
+	Frustum frustum = Frustum::FromMatrix(proj * view);
+
+	AABB unit = { Fvec3(-0.5f), Fvec3(0.5f) };
+
+	// Unit boxes along a line crossing the view from behind the camera to
+	// past the far plane
+	std::vector<AABB> boxes;
+	std::vector<BoundingSphere> spheres;
+	for (int z = -10; z <= 110; z += 5)
+	{
+		boxes.push_back(TransformAABB(unit, TranslateModel(Fvec3(0.f, 0.f, float(z)))));
+		spheres.push_back(TransformSphere({ Fvec3(0.f), 0.5f }, TranslateModel(Fvec3(0.f, 0.f, float(z)))));
+	}
+
+	std::vector<uint8_t> visible(boxes.size());
+	size_t count = CullAABBs(frustum, boxes, visible);
+	for (size_t i = 0; i < boxes.size(); ++i)
+		WIL_ASSERT(visible[i] == frustum.Intersects(boxes[i]));
+	WIL_ASSERT(!visible.front() && !visible.back() && count == 21);
+
+	count = CullSpheres(frustum, spheres, visible);
+	for (size_t i = 0; i < spheres.size(); ++i)
+		WIL_ASSERT(visible[i] == frustum.Intersects(spheres[i]));
+	WIL_ASSERT(count == 21);
+
+	// Far to the side, then rotated into view
+	AABB side = TransformAABB(unit, TranslateModel(Fvec3(50.f, 0.f, 10.f)));
+	WIL_ASSERT(!frustum.Intersects(side));
+	WIL_ASSERT(frustum.Intersects(TransformAABB(side, RotateModel(Fquat::AxisAngle(Radians(-80.f), {0.f, 1.f, 0.f})))));
+
+	WIL_LOGINFO("{} visible objects", count);
+}
@@ -0,0 +1,66 @@
+#include <wil/log.hpp>
+#include <wil/bvh.hpp>
+#include <wil/transform.hpp>
+
+#include <vector>
+
+using namespace wil;
+
+int main()
+{
+	// Unit boxes on a 32 x 32 x 32 grid
+	AABBTree tree;
+	AABB unit = { Fvec3(-0.5f), Fvec3(0.5f) };
+	std::vector<AABB> boxes;
+	for (int x = 0; x < 32; ++x)
+		for (int y = 0; y < 32; ++y)
+			for (int z = 0; z < 32; ++z)
+			{
+				boxes.push_back(TransformAABB(unit, TranslateModel(Fvec3(x * 4.f, y * 4.f, z * 4.f))));
+				WIL_ASSERT(tree.Update(Entity(boxes.size() - 1), boxes.back()));
+			}
+	WIL_ASSERT(tree.size() == boxes.size() && tree.GetHeight() < 24);
+
+	// Small moves stay in the enlarged leaves
+	for (size_t i = 0; i < boxes.size(); i += 2)
+		WIL_ASSERT(!tree.Update(Entity(i), TransformAABB(boxes[i], TranslateModel(Fvec3(0.05f, 0.f, 0.f)))));
+
+	// Odd boxes jump far away, then half of them are removed
+	for (size_t i = 1; i < boxes.size(); i += 2)
+	{
+		boxes[i] = TransformAABB(boxes[i], TranslateModel(Fvec3(0.f, 500.f, 0.f)));
+		WIL_ASSERT(tree.Update(Entity(i), boxes[i]));
+	}
+	for (size_t i = 1; i < boxes.size(); i += 4)
+		tree.Remove(Entity(i));
+	WIL_ASSERT(tree.size() == boxes.size() * 3 / 4 && !tree.Contains(Entity(1)) && tree.Contains(Entity(3)));
+
+	auto check = [&](auto const& query, auto intersects) {
+		std::vector<uint8_t> found(boxes.size());
+		tree.Query(query, [&](Entity e) { ++found[e]; });
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			WIL_ASSERT(found[i] <= 1);
+			if (tree.Contains(Entity(i)) && intersects(boxes[i]))
+				WIL_ASSERT(found[i]);
+		}
+	};
+
+	Frustum frustum = Frustum::FromMatrix(PerspectiveProjection(Radians(60.f), 1.f, .1f, 50.f)
+		* LookAtView({64.f, 64.f, -10.f}, {64.f, 64.f, 1.f}));
+	check(frustum, [&](AABB const& box) { return frustum.Intersects(box); });
+
+	BoundingSphere sphere = { Fvec3(20.f), 9.f };
+	check(sphere, [&](AABB const& box) { return ((box.min + box.max) * 0.5f - sphere.center).Norm() <= sphere.radius; });
+
+	// Closest box along the x axis through the row y = z = 8
+	Ray ray = { Fvec3(-10.f, 8.f, 8.f), Fvec3(1.f, 0.f, 0.f) };
+	Entity hit = NULL_ENTITY;
+	tree.Raycast(ray, 1000.f, [&](Entity e, float t) {
+		hit = e;
+		return t;
+	});
+	WIL_ASSERT(hit == Entity(2 * 32 + 2));
+
+	WIL_LOGINFO("{} entities, height {}", tree.size(), tree.GetHeight());
+}